@@ -0,0 +1,34 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "alloc-stats.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+static std::atomic<size_t> allocation_count(0);
+static std::atomic<size_t> allocation_bytes(0);
+
+size_t HeapAllocationCount() { return allocation_count.load(); }
+size_t HeapAllocationBytes() { return allocation_bytes.load(); }
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    void *result = malloc(size ? size : 1);
+    if (result == NULL)
+        throw std::bad_alloc();
+    return result;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
@@ -0,0 +1,15 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Counting of heap allocations, to keep an eye on allocator traffic.
+ */
+#ifndef PNP_ALLOC_STATS_H
+#define PNP_ALLOC_STATS_H
+
+#include <stddef.h>
+
+// Number of calls to operator new and the bytes requested so far.
+size_t HeapAllocationCount();
+size_t HeapAllocationBytes();
+
+#endif  // PNP_ALLOC_STATS_H
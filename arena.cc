@@ -0,0 +1,87 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+// Blocks start small, so that tiny tables don't waste much, and double
+// in size up to a limit.
+static const size_t kFirstBlockSize = 64 << 10;
+static const size_t kMaxBlockSize = 4 << 20;
+static const size_t kAlignment = alignof(max_align_t);
+
+Arena::Arena()
+    : pos_(NULL), end_(NULL),
+      next_block_size_(kFirstBlockSize), bytes_reserved_(0) {}
+
+Arena::~Arena() {
+    Free();
+}
+
+Arena::Arena(Arena &&other)
+    : blocks_(std::move(other.blocks_)), pos_(other.pos_), end_(other.end_),
+      next_block_size_(other.next_block_size_),
+      bytes_reserved_(other.bytes_reserved_) {
+    other.blocks_.clear();
+    other.pos_ = other.end_ = NULL;
+    other.next_block_size_ = kFirstBlockSize;
+    other.bytes_reserved_ = 0;
+}
+
+Arena &Arena::operator=(Arena &&other) {
+    if (this != &other) {
+        Free();
+        blocks_ = std::move(other.blocks_);
+        pos_ = other.pos_;
+        end_ = other.end_;
+        next_block_size_ = other.next_block_size_;
+        bytes_reserved_ = other.bytes_reserved_;
+        other.blocks_.clear();
+        other.pos_ = other.end_ = NULL;
+        other.next_block_size_ = kFirstBlockSize;
+        other.bytes_reserved_ = 0;
+    }
+    return *this;
+}
+
+void Arena::Free() {
+    for (char *block : blocks_) {
+        delete [] block;
+    }
+    blocks_.clear();
+}
+
+void *Arena::Allocate(size_t size) {
+    return AllocateAligned(size, kAlignment);
+}
+
+void *Arena::AllocateAligned(size_t size, size_t alignment) {
+    if (pos_ != NULL) {
+        const size_t misalign = (uintptr_t) pos_ & (alignment - 1);
+        if (misalign) pos_ = std::min(end_, pos_ + alignment - misalign);
+    }
+    if (pos_ == NULL || size > (size_t)(end_ - pos_)) {
+        const size_t block_size = std::max(size, next_block_size_);
+        char *block = new char[block_size];
+        blocks_.push_back(block);
+        pos_ = block;
+        end_ = block + block_size;
+        bytes_reserved_ += block_size;
+        next_block_size_ = std::min(2 * next_block_size_, kMaxBlockSize);
+    }
+    void *result = pos_;
+    pos_ += size;
+    return result;
+}
+
+const char *Arena::StoreString(const char *str, size_t len) {
+    char *result = (char*) AllocateAligned(len + 1, 1);
+    memcpy(result, str, len);
+    result[len] = '\0';
+    return result;
+}
@@ -0,0 +1,45 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Bump allocator: memory is handed out from a few large blocks and only
+ * freed all at once when the arena goes away.
+ */
+#ifndef PNP_ARENA_H
+#define PNP_ARENA_H
+
+#include <stddef.h>
+
+#include <vector>
+
+class Arena {
+public:
+    Arena();
+    ~Arena();
+
+    Arena(Arena &&other);
+    Arena &operator=(Arena &&other);
+
+    // Allocate "size" bytes, aligned for any type.
+    void *Allocate(size_t size);
+
+    // Copy of the "len" bytes at "str", nul-terminated.
+    const char *StoreString(const char *str, size_t len);
+
+    size_t block_count() const { return blocks_.size(); }
+    size_t bytes_reserved() const { return bytes_reserved_; }
+
+private:
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void Free();
+    void *AllocateAligned(size_t size, size_t alignment);  // power of two.
+
+    std::vector<char*> blocks_;
+    char *pos_;
+    char *end_;
+    size_t next_block_size_;
+    size_t bytes_reserved_;
+};
+
+#endif  // PNP_ARENA_H
@@ -0,0 +1,219 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Compiled board cache (.rptc): the parts of a board in a flat binary
+ * format, so that repeated runs on the same rpt file don't have to parse it
+ * again. The cache is a local artifact: all values are in native byte order;
+ * a cache written on a machine with different byte order simply doesn't
+ * match the version field and is ignored.
+ *
+ * Layout, all offsets in bytes from the start of the file:
+ *   CacheHeader
+ *   CachePart[part_count]      at part_offset
+ *   CachePad[pad_count]        at pad_offset. Reserved for paste dispensing;
+ *                              pads are not collected yet so this is empty.
+ *   char strings[string_size]  at string_offset. string_count nul-terminated
+ *                              strings; the n-th string has ID n.
+ */
+
+#include "board.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mapped-file.h"
+
+namespace {
+const char kCacheMagic[8] = { 'R', 'P', 'T', '2', 'P', 'N', 'P', 'C' };
+const uint32_t kCacheVersion = 2;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t source_hash;      // HashContent() of the rpt file.
+    uint64_t source_size;
+    float board_w, board_h;
+    uint32_t part_count, part_offset;
+    uint32_t pad_count, pad_offset;
+    uint32_t string_count, string_size, string_offset;
+};
+
+struct CachePart {
+    uint32_t component_name, value, footprint;  // string IDs.
+    float x, y;
+    float box_x0, box_y0, box_x1, box_y1;
+    float angle;
+};
+
+struct CachePad {
+    uint32_t part;   // index in part table.
+    float x, y, w, h;
+    float drill;
+};
+
+}  // namespace
+
+// FNV-1a, but eating 64 bits at a time. Not meant to be cryptographic,
+// just to notice that the rpt file changed.
+uint64_t Board::HashContent(const char *data, size_t size) {
+    const uint64_t kPrime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    size_t i = 0;
+    for (/**/; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * kPrime;
+    }
+    for (/**/; i < size; ++i) {
+        hash = (hash ^ (unsigned char) data[i]) * kPrime;
+    }
+    return hash;
+}
+
+bool Board::ReadCache(const std::string &cache_file,
+                      uint64_t source_hash, uint64_t source_size) {
+    if (access(cache_file.c_str(), R_OK) != 0)
+        return false;   // No cache. Nothing to complain about.
+    MappedFile cache;
+    if (!cache.Map(cache_file))
+        return false;
+    const char *const data = cache.data();
+    const size_t size = cache.size();
+    CacheHeader header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0
+        || header.version != kCacheVersion
+        || header.header_size != sizeof(header)) {
+        fprintf(stderr, "%s: not a usable cache; ignoring.\n",
+                cache_file.c_str());
+        return false;
+    }
+    if (header.source_hash != source_hash
+        || header.source_size != source_size) {
+        fprintf(stderr, "%s: stale cache; parsing rpt instead.\n",
+                cache_file.c_str());
+        return false;
+    }
+    if ((uint64_t) header.part_offset
+        + (uint64_t) header.part_count * sizeof(CachePart) > size
+        || (uint64_t) header.pad_offset
+        + (uint64_t) header.pad_count * sizeof(CachePad) > size
+        || (uint64_t) header.string_offset + header.string_size > size
+        || (header.string_size > 0
+            && data[header.string_offset + header.string_size - 1] != '\0')) {
+        fprintf(stderr, "%s: truncated cache; ignoring.\n",
+                cache_file.c_str());
+        return false;
+    }
+
+    // Strings are interned in sequence; their IDs in our table might differ.
+    StringTable *table_strings = parts_.mutable_strings();
+    std::vector<int> id_map;
+    id_map.reserve(header.string_count);
+    const char *str = data + header.string_offset;
+    const char *const strings_end = str + header.string_size;
+    while (str < strings_end && id_map.size() < header.string_count) {
+        const size_t len = strlen(str);
+        id_map.push_back(table_strings->Intern(str, len));
+        str += len + 1;
+    }
+    if (id_map.size() != header.string_count) {
+        fprintf(stderr, "%s: broken string table.\n", cache_file.c_str());
+        Clear();
+        return false;
+    }
+
+    const CachePart *cache_parts
+        = (const CachePart*) (data + header.part_offset);
+    board_dim_.w = header.board_w;
+    board_dim_.h = header.board_h;
+    parts_.Reserve(header.part_count);
+    for (uint32_t i = 0; i < header.part_count; ++i) {
+        const CachePart &c = cache_parts[i];
+        if (c.component_name >= header.string_count
+            || c.value >= header.string_count
+            || c.footprint >= header.string_count) {
+            fprintf(stderr, "%s: broken string reference.\n",
+                    cache_file.c_str());
+            Clear();
+            return false;
+        }
+        Box box;
+        box.p0.Set(c.box_x0, c.box_y0);
+        box.p1.Set(c.box_x1, c.box_y1);
+        parts_.Add(id_map[c.component_name], id_map[c.value],
+                   id_map[c.footprint], Position(c.x, c.y), box, c.angle);
+    }
+    return true;
+}
+
+bool Board::WriteCache(const std::string &cache_file,
+                       uint64_t source_hash, uint64_t source_size) const {
+    const StringTable &table_strings = parts_.strings();
+    std::string strings;
+    for (int id = 0; id < table_strings.size(); ++id) {
+        strings.append(table_strings.str(id), table_strings.length(id) + 1);
+    }
+    std::vector<CachePart> cache_parts;
+    cache_parts.reserve(parts_.size());
+    for (int i = 0; i < parts_.size(); ++i) {
+        const Box box = parts_.bounding_box(i);
+        CachePart c;
+        c.component_name = parts_.component_name_id(i);
+        c.value = parts_.value_id(i);
+        c.footprint = parts_.footprint_id(i);
+        c.x = parts_.x()[i];
+        c.y = parts_.y()[i];
+        c.box_x0 = box.p0.x;
+        c.box_y0 = box.p0.y;
+        c.box_x1 = box.p1.x;
+        c.box_y1 = box.p1.y;
+        c.angle = parts_.angle(i);
+        cache_parts.push_back(c);
+    }
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.header_size = sizeof(header);
+    header.source_hash = source_hash;
+    header.source_size = source_size;
+    header.board_w = board_dim_.w;
+    header.board_h = board_dim_.h;
+    header.part_count = cache_parts.size();
+    header.part_offset = sizeof(header);
+    header.pad_count = 0;
+    header.pad_offset = header.part_offset
+        + cache_parts.size() * sizeof(CachePart);
+    header.string_count = table_strings.size();
+    header.string_size = strings.size();
+    header.string_offset = header.pad_offset;
+
+    // Write to a temporary file first, so that an interrupted write never
+    // leaves a half-baked cache behind.
+    const std::string tmp_file = cache_file + ".tmp";
+    FILE *out = fopen(tmp_file.c_str(), "wb");
+    if (!out) {
+        perror(tmp_file.c_str());
+        return false;
+    }
+    bool success = fwrite(&header, sizeof(header), 1, out) == 1;
+    if (!cache_parts.empty()) {
+        success &= (fwrite(cache_parts.data(), sizeof(CachePart),
+                           cache_parts.size(), out) == cache_parts.size());
+    }
+    success &= (fwrite(strings.data(), 1, header.string_size, out)
+                == header.string_size);
+    success &= (fclose(out) == 0);
+    if (!success || rename(tmp_file.c_str(), cache_file.c_str()) != 0) {
+        perror(cache_file.c_str());
+        remove(tmp_file.c_str());
+        return false;
+    }
+    return true;
+}
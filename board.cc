@@ -5,8 +5,9 @@
 #include "board.h"
 
 #include <math.h>
-#include <fstream>
+#include <stdio.h>
 
+#include "mapped-file.h"
 #include "rpt-parser.h"
 
 namespace {
@@ -14,10 +15,8 @@ namespace {
     // Collect the parts from parse events.
 class PartCollector : public ParseEventReceiver {
 public:
-    PartCollector(std::vector<const Part*> *parts,
-                  Dimension *board_dimension)
-        : current_part_(NULL),
-          collected_parts_(parts), board_dimension_(board_dimension) {}
+    PartCollector(PartTable *parts, Dimension *board_dimension)
+        : collected_parts_(parts), board_dimension_(board_dimension) {}
 
 protected:
     void StartBoard(float max_x, float max_y) override {
@@ -27,26 +26,29 @@ protected:
 
     void StartComponent(const std::string &c) override {
         in_pad_ = false;
-        current_part_ = new Part();
-        current_part_->component_name = c;
+        current_part_ = PendingPart();
+        current_part_.component_name_id = Intern(c);
         drillSum = 0;
         angle_ = 0;
     }
 
     void Value(const std::string &c) override {
-        current_part_->value = c;
+        current_part_.value_id = Intern(c);
     }
 
     void Footprint(const std::string &c) override {
-        current_part_->footprint = c;
+        current_part_.footprint_id = Intern(c);
     }
 
     void EndComponent() override {
         if (drillSum > 0)
-            delete current_part_;  // through-hole. We're not interested in that.
-        else
-            collected_parts_->push_back(current_part_);
-        current_part_ = NULL;
+            return;  // through-hole. We're not interested in that.
+        collected_parts_->Add(current_part_.component_name_id,
+                              current_part_.value_id,
+                              current_part_.footprint_id,
+                              current_part_.pos,
+                              current_part_.bounding_box,
+                              current_part_.angle);
     }
 
     // Not caring about pads right now.
@@ -62,8 +64,8 @@ protected:
             rotateXY(&x, &y);
             pad_position_.Set(x, y);
         } else {
-            current_part_->pos.x = x;
-            current_part_->pos.y = y;
+            current_part_.pos.x = x;
+            current_part_.pos.y = y;
         }
     }
 
@@ -71,17 +73,17 @@ protected:
         if (in_pad_) {
             float x, y;
             x = pad_position_.x - w/2;
-            if (x < current_part_->bounding_box.p0.x)
-                current_part_->bounding_box.p0.x = x;
+            if (x < current_part_.bounding_box.p0.x)
+                current_part_.bounding_box.p0.x = x;
             x = pad_position_.x + w/2;
-            if (x > current_part_->bounding_box.p1.x)
-                current_part_->bounding_box.p1.x = x;
+            if (x > current_part_.bounding_box.p1.x)
+                current_part_.bounding_box.p1.x = x;
             y = pad_position_.y - h/2;
-            if (y < current_part_->bounding_box.p0.y)
-                current_part_->bounding_box.p0.y = y;
+            if (y < current_part_.bounding_box.p0.y)
+                current_part_.bounding_box.p0.y = y;
             y = pad_position_.y + h/2;
-            if (y > current_part_->bounding_box.p1.y)
-                current_part_->bounding_box.p1.y = y;
+            if (y > current_part_.bounding_box.p1.y)
+                current_part_.bounding_box.p1.y = y;
         }
     }
 
@@ -96,10 +98,25 @@ protected:
         // mmh, and it looks like it turned in negative direction ? Probably part
         // of the mirroring.
         angle_ = -M_PI * angle / 180.0;
-        current_part_->angle = angle; // change to angle_ if you really want radians
+        current_part_.angle = angle; // change to angle_ if you really want radians
     }
 
 private:
+    // The part we are currently collecting. Only added to the table at the
+    // end of the module, once we know it is not through-hole.
+    struct PendingPart {
+        PendingPart() : component_name_id(0), value_id(0), footprint_id(0),
+                        angle(0) {}
+        int component_name_id, value_id, footprint_id;
+        ::Position pos;
+        Box bounding_box;
+        float angle;
+    };
+
+    int Intern(const std::string &s) {
+        return collected_parts_->mutable_strings()->Intern(s);
+    }
+
     void rotateXY(float *x, float *y) {
         float xnew = *x * cos(angle_) - *y * sin(angle_);
         float ynew = *x * sin(angle_) + *y * cos(angle_);
@@ -113,27 +130,158 @@ private:
     bool in_pad_;
 
     ::Position pad_position_;
-    std::string component_name_;
-    Part *current_part_;
-    std::vector<const Part*> *collected_parts_;
+    PendingPart current_part_;
+    PartTable *collected_parts_;
     Dimension *board_dimension_;
 };
 }  // namespace
 
+void PartTable::Reserve(int n) {
+    for (std::vector<float> *column : { &x_, &y_, &angle_, &box_x0_,
+                &box_y0_, &box_x1_, &box_y1_ }) {
+        column->reserve(n);
+    }
+    for (std::vector<int> *column : { &component_name_id_, &value_id_,
+                &footprint_id_, &component_key_id_ }) {
+        column->reserve(n);
+    }
+}
+
+int PartTable::Add(int component_name_id, int value_id, int footprint_id,
+                   const Position &pos, const Box &bounding_box, float angle) {
+    x_.push_back(pos.x);
+    y_.push_back(pos.y);
+    angle_.push_back(angle);
+    box_x0_.push_back(bounding_box.p0.x);
+    box_y0_.push_back(bounding_box.p0.y);
+    box_x1_.push_back(bounding_box.p1.x);
+    box_y1_.push_back(bounding_box.p1.y);
+    component_name_id_.push_back(component_name_id);
+    value_id_.push_back(value_id);
+    footprint_id_.push_back(footprint_id);
+    component_key_id_.push_back(ComponentKeyId(footprint_id, value_id));
+    return x_.size() - 1;
+}
+
+int PartTable::ComponentKeyId(int footprint_id, int value_id) {
+    const uint64_t pair = ((uint64_t) footprint_id << 32) | (uint32_t) value_id;
+    auto found = key_for_pair_.find(pair);
+    if (found != key_for_pair_.end())
+        return found->second;
+    const std::string key = std::string(strings_.str(footprint_id))
+        + "@" + strings_.str(value_id);
+    const int key_id = component_keys_.Intern(key);
+    key_for_pair_[pair] = key_id;
+    return key_id;
+}
+
+void PartTable::Append(const PartTable &other) {
+    // String IDs are local to each table; map them over.
+    std::vector<int> id_map(other.strings_.size());
+    for (int id = 0; id < other.strings_.size(); ++id) {
+        id_map[id] = strings_.Intern(other.strings_.str(id),
+                                     other.strings_.length(id));
+    }
+    Reserve(size() + other.size());
+    for (int i = 0; i < other.size(); ++i) {
+        Add(id_map[other.component_name_id_[i]],
+            id_map[other.value_id_[i]],
+            id_map[other.footprint_id_[i]],
+            other.pos(i), other.bounding_box(i), other.angle_[i]);
+    }
+}
+
+Box PartTable::bounding_box(int i) const {
+    Box result;
+    result.p0.Set(box_x0_[i], box_y0_[i]);
+    result.p1.Set(box_x1_[i], box_y1_[i]);
+    return result;
+}
+
+Part PartTable::part(int i) const {
+    Part result;
+    result.index = i;
+    result.component_name = strings_.str(component_name_id_[i]);
+    result.value = strings_.str(value_id_[i]);
+    result.footprint = strings_.str(footprint_id_[i]);
+    result.component_key_id = component_key_id_[i];
+    result.component_key = component_keys_.str(component_key_id_[i]);
+    result.pos.Set(x_[i], y_[i]);
+    result.bounding_box = bounding_box(i);
+    result.angle = angle_[i];
+    return result;
+}
+
 Board::Board() {}
 
-Board::~Board() {
-    for (const Part* part : parts_) {
-        delete part;
+Board::~Board() {}
+
+void Board::Clear() {
+    parts_ = PartTable();
+    board_dim_ = Dimension();
+    spatial_index_ = SpatialIndex();
+    part_for_name_id_.clear();
+}
+
+void Board::BuildIndices() {
+    spatial_index_ = SpatialIndex(parts_.x(), parts_.y(), parts_.size());
+    part_for_name_id_.assign(parts_.strings().size(), -1);
+    for (int i = parts_.size() - 1; i >= 0; --i) {  // first one wins.
+        part_for_name_id_[parts_.component_name_id(i)] = i;
     }
 }
 
-bool Board::ReadPartsFromRpt(const std::string& filename) {
-    PartCollector collector(&parts_, &board_dim_);
-    std::ifstream in(filename);
-    if (!in.is_open()) {
-        fprintf(stderr, "Can't open %s\n", filename.c_str());
+int Board::FindPartByName(const std::string &component_name) const {
+    const int name_id = parts_.strings().Find(component_name);
+    return name_id < 0 ? -1 : part_for_name_id_[name_id];
+}
+
+void Board::DebugPrintStats() const {
+    const StringTable &strings = parts_.strings();
+    fprintf(stderr, "%d parts, %d distinct strings in %zu arena blocks "
+            "(%zu kiB)\n", parts_.size(), strings.size(),
+            strings.arena().block_count(), strings.arena().bytes_reserved() >> 10);
+}
+
+bool Board::ReadPartsFromRpt(const std::string& filename, int threads,
+                             bool write_cache) {
+    MappedFile rpt;
+    if (!rpt.Map(filename))
         return false;
+    const std::string cache_file = filename + "c";
+    const uint64_t hash = HashContent(rpt.data(), rpt.size());
+    if (write_cache || !ReadCache(cache_file, hash, rpt.size())) {
+        if (!ParseRpt(rpt.data(), rpt.size(), threads))
+            return false;
+        if (write_cache && !WriteCache(cache_file, hash, rpt.size()))
+            fprintf(stderr, "Couldn't write cache %s\n", cache_file.c_str());
+    }
+    BuildIndices();
+    return true;
+}
+
+bool Board::ParseRpt(const char *data, size_t size, int threads) {
+    if (threads <= 1) {
+        PartCollector collector(&parts_, &board_dim_);
+        return RptParse(data, size, &collector);
+    }
+
+    // A few chunks per thread, so that a slow chunk doesn't hold up the rest.
+    const int chunk_count = 4 * threads;
+    PartCollector header_collector(&parts_, &board_dim_);
+    std::vector<PartTable> chunk_parts(chunk_count);
+    std::vector<Dimension> unused_dim(chunk_count);
+    std::vector<PartCollector> collectors;
+    collectors.reserve(chunk_count);
+    std::vector<ParseEventReceiver*> receivers;
+    for (int i = 0; i < chunk_count; ++i) {
+        collectors.push_back(PartCollector(&chunk_parts[i], &unused_dim[i]));
+        receivers.push_back(&collectors.back());
+    }
+    const bool success = RptParseParallel(data, size, threads,
+                                          &header_collector, receivers);
+    for (const PartTable &chunk : chunk_parts) {
+        parts_.Append(chunk);
     }
-    return RptParse(&in, &collector);
+    return success;
 }
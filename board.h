@@ -6,45 +6,135 @@
 #ifndef PNP_BOARD_H
 #define PNP_BOARD_H
 
+#include <stdint.h>
+
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "rpt2pnp.h"
+#include "spatial-index.h"
+#include "string-table.h"
 
-// A part on the board.
+// A part on the board. This is a lightweight view of one row in the
+// PartTable; the strings point into the table and live as long as it does.
 struct Part {
-    Part() : pos(), angle(0) {}
-    std::string component_name;  // component name, e.g. R42
-    std::string value;           // component value, e.g. 100k
-    std::string footprint;       // footprint of component if known.
+    Part() : index(-1), component_name(""), value(""), footprint(""),
+             component_key_id(0), component_key(""), pos(), angle(0) {}
+    int index;                   // Index in the PartTable.
+    const char *component_name;  // component name, e.g. R42
+    const char *value;           // component value, e.g. 100k
+    const char *footprint;       // footprint of component if known.
+    int component_key_id;        // ID of component_key in the PartTable.
+    const char *component_key;   // <footprint>@<value>
     Position pos;                // Relative to board
     Box bounding_box;            // relative to pos
     float angle;                 // Rotation
     // vector<Pad> // for paste dispensing. Not needed here for now.
 };
 
+// All the parts of a board, stored column-wise: one contiguous array per
+// property, so that loops over positions don't chase pointers. Strings are
+// interned in the table's StringTable and referred to by ID; their
+// characters live in its arena. So a table is a handful of large
+// allocations, no matter how many parts, and is freed just as quickly.
+class PartTable {
+public:
+    int size() const { return x_.size(); }
+    void Reserve(int n);
+
+    // Add a part with the given string IDs from strings(). Returns its index.
+    int Add(int component_name_id, int value_id, int footprint_id,
+            const Position &pos, const Box &bounding_box, float angle);
+
+    // Append all parts of another table.
+    void Append(const PartTable &other);
+
+    // View of part "i".
+    Part part(int i) const;
+
+    Position pos(int i) const { return Position(x_[i], y_[i]); }
+    float angle(int i) const { return angle_[i]; }
+    Box bounding_box(int i) const;
+
+    // Raw position columns, size() elements each.
+    const float *x() const { return x_.data(); }
+    const float *y() const { return y_.data(); }
+
+    int component_name_id(int i) const { return component_name_id_[i]; }
+    int value_id(int i) const { return value_id_[i]; }
+    int footprint_id(int i) const { return footprint_id_[i]; }
+
+    // The <footprint>@<value> key that identifies the kind of component,
+    // e.g. to find the tape it is on. Assigned once when a part is added.
+    int component_key_id(int i) const { return component_key_id_[i]; }
+    const StringTable &component_keys() const { return component_keys_; }
+
+    const StringTable &strings() const { return strings_; }
+    StringTable *mutable_strings() { return &strings_; }
+
+private:
+    int ComponentKeyId(int footprint_id, int value_id);
+
+    std::vector<float> x_, y_, angle_;
+    std::vector<float> box_x0_, box_y0_, box_x1_, box_y1_;
+    std::vector<int> component_name_id_, value_id_, footprint_id_;
+    std::vector<int> component_key_id_;
+    StringTable strings_;
+    StringTable component_keys_;
+    // (footprint_id, value_id) -> component key ID, so that the key string
+    // is only built once per distinct combination.
+    std::unordered_map<uint64_t, int> key_for_pair_;
+};
+
 // Representation of the board and its components.
 class Board {
 public:
-    typedef std::vector<const Part*> PartList;
-
     Board();
     ~Board();
 
-    // Read from kicad rpt file.
-    bool ReadPartsFromRpt(const std::string& filename);
+    // Read from kicad rpt file. With more than one thread, the modules
+    // are parsed in parallel. Part order is the same in either case.
+    //
+    // If there is a compiled board cache "<filename>c" that matches the
+    // content of the rpt file, the parts are read from that instead.
+    // With "write_cache", the rpt file is always parsed and the cache
+    // is written or refreshed.
+    bool ReadPartsFromRpt(const std::string& filename, int threads = 1,
+                          bool write_cache = false);
 
     // Parts. All positions are referenced to (0,0)
-    const PartList& parts() const { return parts_; }
+    const PartTable& parts() const { return parts_; }
+
+    // Spatial index of all part positions; IDs are indices in parts().
+    const SpatialIndex& spatial_index() const { return spatial_index_; }
+
+    // Index of part with the given component name, -1 if there is none.
+    int FindPartByName(const std::string &component_name) const;
 
     // The outline of the board.
     const Dimension& dimension() const { return board_dim_; }
 
     int PartCount() const { return parts_.size(); }
 
+    void DebugPrintStats() const;  // print to stderr.
+
 private:
+    void Clear();
+    void BuildIndices();
+    bool ParseRpt(const char *data, size_t size, int threads);
+
+    // Compiled board cache (board-cache.cc)
+    static uint64_t HashContent(const char *data, size_t size);
+    bool ReadCache(const std::string &cache_file,
+                   uint64_t source_hash, uint64_t source_size);
+    bool WriteCache(const std::string &cache_file,
+                    uint64_t source_hash, uint64_t source_size) const;
+
     Dimension board_dim_;
-    PartList parts_;
+    PartTable parts_;
+    SpatialIndex spatial_index_;
+    std::vector<int> part_for_name_id_;   // component name ID -> part.
 };
 
 #endif  // PNP_BOARD_H
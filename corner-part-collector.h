@@ -20,7 +20,10 @@ public:
 
     void Update(const Position &pos, const Part &part) {
         for (int i = 0; i < 4; ++i) {
-            const float distance = Distance(corners_[i], pos);
+            // Only comparing, so squared distance is good enough.
+            const float dx = corners_[i].x - pos.x;
+            const float dy = corners_[i].y - pos.y;
+            const float distance = dx * dx + dy * dy;
             if (corner_distance_[i] < 0 || distance < corner_distance_[i]) {
                 corner_distance_[i] = distance;
                 closest_match_[i] = pos;
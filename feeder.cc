@@ -0,0 +1,78 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+#include <assert.h>
+
+#include "feeder.h"
+#include <stdio.h>
+
+Feeder::Feeder()
+    : z_(0),
+      dx_(0), dy_(0),
+      angle_(0),
+      capacity_(1000), consumed_(0) {
+}
+
+void Feeder::SetFirstComponentPosition(float x, float y, float z) {
+    origin_.x = x;
+    origin_.y = y;
+    z_ = z;
+}
+
+void Feeder::SetComponentSpacing(float dx, float dy) {
+    dx_ = dx;
+    dy_ = dy;
+    // No height difference between components (I hope :) )
+}
+
+void Feeder::SetNumberComponents(int n) {
+    capacity_ = n;
+}
+
+bool Feeder::GetPos(float *x, float *y, float *z) const {
+    assert(x != NULL && y != NULL && z != NULL);
+    if (count() <= 0)
+        return false;
+
+    const Position pos = PositionOf(consumed_);
+    *x = pos.x;
+    *y = pos.y;
+    *z = z_;
+    return true;
+}
+
+bool Feeder::Advance() {
+    if (count() <= 0)
+        return false;
+    ++consumed_;
+    return true;
+}
+
+void Feeder::DebugPrint() const {
+    fprintf(stderr, "%p: origin: (%.2f, %.2f, %.2f) delta: (%.2f,%.2f) "
+            "count: %d", this, origin_.x, origin_.y, z_, dx_, dy_, count());
+}
+
+// Computed from the origin each time, so there is no rounding error
+// accumulating along the tape.
+Position Tape::PositionOf(int index) const {
+    return Position(origin_.x + index * dx_, origin_.y + index * dy_);
+}
+
+Tray::Tray() : columns_(1) {}
+
+void Tray::SetGrid(int columns, int rows) {
+    assert(columns > 0 && rows > 0);
+    columns_ = columns;
+    SetNumberComponents(columns * rows);
+}
+
+Position Tray::PositionOf(int index) const {
+    return Position(origin_.x + (index % columns_) * dx_,
+                    origin_.y + (index / columns_) * dy_);
+}
+
+void Tray::DebugPrint() const {
+    Feeder::DebugPrint();
+    fprintf(stderr, " columns: %d", columns_);
+}
@@ -0,0 +1,80 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Feeders presenting components to be picked: tapes and trays.
+ */
+
+#ifndef PNP_FEEDER_H
+#define PNP_FEEDER_H
+
+#include "rpt2pnp.h"
+
+// Components are at positions given by their index, counting from the first
+// one. Taking components moves a cursor; the positions of all of them are
+// known up front, so planning can look ahead without changing the feeder.
+class Feeder {
+public:
+    Feeder();
+    virtual ~Feeder() {}
+
+    void SetFirstComponentPosition(float x, float y, float z);
+    void SetComponentSpacing(float dx, float dy);
+    void SetNumberComponents(int n);
+    void SetAngle(float a) { angle_ = a; }
+
+    // TODO: this is not accurate. We should make this relative to the
+    // slant of the tape, e.g. its angle on the x/y table according to
+    // SetComponentSpacing()
+    float angle() const { return angle_; }
+
+    // Pick-up height of the components.
+    float height() const { return z_; }
+
+    // Position of component "index", whether taken already or not.
+    virtual Position PositionOf(int index) const = 0;
+
+    int capacity() const { return capacity_; }   // Components to begin with.
+    int consumed() const { return consumed_; }   // Index of the next one.
+    int count() const { return capacity_ - consumed_; }   // Left.
+
+    // Get next component position. Returns 'true' if there is any, 'false'
+    // if we exhausted our components.
+    bool GetPos(float *x, float *y, float *z) const;
+
+    // Takes the next component, so each call yields a different position
+    bool Advance();
+
+    virtual void DebugPrint() const;  // print to stderr.
+
+protected:
+    Position origin_;
+    float z_;
+    float dx_, dy_;
+    float angle_;
+    int capacity_;
+    int consumed_;
+};
+
+// Components in a line, "spacing" apart.
+class Tape : public Feeder {
+public:
+    Position PositionOf(int index) const override;
+};
+
+// Components in a grid, taken row by row. The spacing is the distance
+// between columns (dx) and between rows (dy).
+class Tray : public Feeder {
+public:
+    Tray();
+
+    // Size of the grid; also sets the number of components to all of them.
+    void SetGrid(int columns, int rows);
+
+    Position PositionOf(int index) const override;
+    void DebugPrint() const override;
+
+private:
+    int columns_;
+};
+
+#endif  // PNP_FEEDER_H
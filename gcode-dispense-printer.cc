@@ -17,9 +17,9 @@ GCodeDispensePrinter::GCodeDispensePrinter(float init_ms, float area_ms)
 void GCodeDispensePrinter::Init(const Dimension& dim) {
     //OptimizeParts(&parts);
 
-    printf("; rpt2pnp -d %.2f -D %.2f file.rpt\n", init_ms_, area_ms_);
+    out_.Printf("; rpt2pnp -d %.2f -D %.2f file.rpt\n", init_ms_, area_ms_);
     // G-code preamble. Set feed rate, homing etc.
-    printf(
+    out_.Append(
            //    "G28\n" assume machine is already homed before g-code is executed
            "G21\n" // set to mm
            "G0 F20000\n"
@@ -30,14 +30,15 @@ void GCodeDispensePrinter::Init(const Dimension& dim) {
 
 void GCodeDispensePrinter::PrintPart(const Part &part) {
     // move to new position, above board
-    printf("G0 X%.3f Y%.3f E%.3f Z" Z_HOVER_DISPENSER " ; comp=%s val=%s\n",
-           // "G1 Z" Z_HIGH_UP_DISPENSER "\n", // high above to have paste is well separated
-           part.pos.x, part.pos.y, part.angle,
-           part.component_name.c_str(), part.value.c_str());
+    out_.Printf("G0 X%.3f Y%.3f E%.3f Z" Z_HOVER_DISPENSER
+                " ; comp=%s val=%s\n",
+                // "G1 Z" Z_HIGH_UP_DISPENSER "\n", // high above to have paste is well separated
+                part.pos.x, part.pos.y, part.angle,
+                part.component_name, part.value);
 }
 
 void GCodeDispensePrinter::Finish() {
-    printf(";done\n");
+    out_.Append(";done\n");
 }
 
 
@@ -48,7 +49,7 @@ GCodeCornerIndicator::GCodeCornerIndicator(float init_ms, float area_ms)
 void GCodeCornerIndicator::Init(const Dimension& dim) {
     corners_.SetCorners(0, 0, dim.w, dim.h);
     // G-code preamble. Set feed rate, homing etc.
-    printf(
+    out_.Append(
            //    "G28\n" assume machine is already homed before g-code is executed
            "G21\n" // set to mm
            "G1 F2000\n"
@@ -64,12 +65,12 @@ void GCodeCornerIndicator::Finish() {
     for (int i = 0; i < 4; ++i) {
         const ::Part &p = corners_.get_part(i);
         const Position pos = corners_.get_closest(i);
-        printf("G0 X%.3f Y%.3f Z" Z_DISPENSING " ; comp=%s\n"
-               "G4 P2000 ; wtf\n"
-               "G0 Z" Z_HIGH_UP_DISPENSER "\n",
-               pos.x, pos.y, p.component_name.c_str()
-               );
+        out_.Printf("G0 X%.3f Y%.3f Z" Z_DISPENSING " ; comp=%s\n"
+                    "G4 P2000 ; wtf\n"
+                    "G0 Z" Z_HIGH_UP_DISPENSER "\n",
+                    pos.x, pos.y, p.component_name
+                    );
 
     }
-    printf(";done\n");
+    out_.Append(";done\n");
 }
@@ -0,0 +1,384 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "gcode-peephole.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "number-parser.h"
+
+static const char kAxisLetter[] = "XYZE";
+
+int GCodePeephole::ParseRewrites(const char *list) {
+    int result = 0;
+    std::string name;
+    for (const char *c = list; ; ++c) {
+        if (*c != ',' && *c != '\0') {
+            name.push_back(*c);
+            continue;
+        }
+        if (name == "all") result |= REWRITE_ALL;
+        else if (name == "lift") result |= REWRITE_LIFT;
+        else if (name == "noop") result |= REWRITE_NOOP;
+        else if (name == "feed") result |= REWRITE_FEED;
+        else if (name == "dwell") result |= REWRITE_DWELL;
+        else return -1;
+        name.clear();
+        if (*c == '\0')
+            return result;
+    }
+}
+
+GCodePeephole::GCodePeephole(FILE *out, const MachineModel &machine,
+                             int rewrites)
+    : out_(out), machine_(machine), rewrites_(rewrites),
+      feed_(0), moved_since_sync_(true),
+      held_kind_(HELD_NONE), held_lift_z_(0), held_dwell_ms_(0),
+      time_in_(machine, NULL, NULL), time_out_(machine, NULL, NULL),
+      lifts_split_(0), noop_lines_(0), noop_words_(0), feed_words_(0),
+      dwells_dropped_(0), dwells_merged_(0) {
+    for (int a = 0; a < AXES; ++a) {
+        position_[a] = 0;
+        known_[a] = false;
+        relative_[a] = false;
+    }
+}
+
+const GCodePeephole::Line::Word *GCodePeephole::Line::Find(char c) const {
+    for (const Word &w : words) {
+        if (w.letter == c) return &w;
+    }
+    return NULL;
+}
+
+void GCodePeephole::Line::Remove(char c) {
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (words[i].letter == c) {
+            words.erase(words.begin() + i);
+            return;
+        }
+    }
+}
+
+bool GCodePeephole::Parse(const char *text, size_t len, Line *line) const {
+    line->command = 0;
+    line->code = -1;
+    line->comment = NULL;
+    line->comment_len = 0;
+    const char *end = text + len;
+    const char *comment = (const char*) memchr(text, ';', len);
+    if (comment) {
+        line->comment = comment;
+        line->comment_len = end - comment;
+        end = comment;
+    }
+    const char *pos = text;
+    while (pos < end) {
+        if (isspace(*pos)) {
+            ++pos;
+            continue;
+        }
+        Line::Word word;
+        word.text = pos;
+        word.letter = toupper(*pos++);
+        while (pos < end && !isspace(*pos)) ++pos;
+        word.len = pos - word.text;
+        word.value = 0;
+        if (word.letter < 'A' || word.letter > 'Z'
+            || (word.len > 1
+                && !ParseFloat(word.text + 1, word.len - 1, &word.value))) {
+            return false;
+        }
+        if (line->command == 0) {
+            line->command = word.letter;
+            line->code = word.value;
+        }
+        line->words.push_back(word);   // First one is the command.
+    }
+    return true;
+}
+
+std::string GCodePeephole::Assemble(const Line &line) {
+    std::string result;
+    for (const Line::Word &w : line.words) {
+        if (!result.empty()) result.push_back(' ');
+        result.append(w.text, w.len);
+    }
+    if (line.comment) {
+        result.push_back(' ');
+        result.append(line.comment, line.comment_len);
+    }
+    return result;
+}
+
+void GCodePeephole::Write(const char *data, size_t len) {
+    const char *end = data + len;
+    while (data < end) {
+        const char *newline = (const char*) memchr(data, '\n', end - data);
+        if (newline == NULL) {
+            partial_.append(data, end - data);
+            return;
+        }
+        if (partial_.empty()) {
+            ProcessLine(data, newline - data);
+        } else {
+            partial_.append(data, newline - data);
+            ProcessLine(partial_.data(), partial_.size());
+            partial_.clear();
+        }
+        data = newline + 1;
+    }
+}
+
+void GCodePeephole::Finish() {
+    if (!partial_.empty()) {
+        ProcessLine(partial_.data(), partial_.size());
+        partial_.clear();
+    }
+    EmitHeld();
+    out_.Flush();
+}
+
+void GCodePeephole::ProcessLine(const char *text, size_t len) {
+    time_in_.ProcessLine(text, len);
+    Line line;
+    if (!Parse(text, len, &line) || line.command == 0) {
+        // Comments and empty lines stay with what is held back.
+        if (held_kind_ != HELD_NONE && line.command == 0) {
+            held_.push_back(std::string(text, len));
+            return;
+        }
+        EmitHeld();
+        Emit(text, len);
+        return;
+    }
+    if (line.command == 'G' && (line.code == 0 || line.code == 1)) {
+        Move(text, len, &line);
+        return;
+    }
+    if (line.command == 'G' && line.code == 4) {
+        Dwell(text, len, line);
+        return;
+    }
+    if (line.command == 'M' && line.code == 42) {
+        SetPin(text, len, line);
+        return;
+    }
+    EmitHeld();
+    Emit(text, len);
+    if (line.command == 'G' && line.code == 28) {
+        const bool all = !line.Find('X') && !line.Find('Y') && !line.Find('Z');
+        for (int a = X; a <= Z; ++a) {
+            if (all || line.Find(kAxisLetter[a])) {
+                position_[a] = 0;
+                known_[a] = true;
+            }
+        }
+        moved_since_sync_ = true;
+    } else if (line.command == 'G' && line.code == 92) {
+        for (int a = 0; a < AXES; ++a) {
+            if (const Line::Word *w = line.Find(kAxisLetter[a])) {
+                position_[a] = w->value;
+                known_[a] = true;
+            }
+        }
+    } else if (line.command == 'G' && (line.code == 90 || line.code == 91)) {
+        // Firmwares differ in whether this also applies to E; only M82
+        // makes E absolute again.
+        for (int a = X; a <= Z; ++a) relative_[a] = (line.code == 91);
+        if (line.code == 91) {
+            relative_[E] = true;
+            Forget();
+        }
+    } else if (line.command == 'M' && (line.code == 82 || line.code == 83)) {
+        relative_[E] = (line.code == 83);
+        known_[E] = false;
+    } else if (line.command == 'T') {
+        known_[E] = false;   // Each tool might have an E position of its own.
+    } else if (line.command == 'G' && line.code != 21) {
+        Forget();   // Units, coordinate systems, ...: who knows.
+    }
+}
+
+void GCodePeephole::Forget() {
+    for (int a = 0; a < AXES; ++a) known_[a] = false;
+}
+
+void GCodePeephole::Move(const char *text, size_t len, Line *line) {
+    int noop_words = 0, feed_words = 0;
+    if (rewrites_ & REWRITE_NOOP) {
+        for (int a = 0; a < AXES; ++a) {
+            const Line::Word *w = line->Find(kAxisLetter[a]);
+            if (w && known_[a] && !relative_[a] && w->value == position_[a]) {
+                line->Remove(kAxisLetter[a]);
+                ++noop_words;
+            }
+        }
+    }
+    const Line::Word *feed = line->Find('F');
+    if ((rewrites_ & REWRITE_FEED) && feed && feed->value == feed_) {
+        line->Remove('F');
+        ++feed_words;
+    } else if (feed) {
+        feed_ = feed->value;
+    }
+    if (line->words.size() == 1 && noop_words + feed_words > 0) {
+        ++noop_lines_;   // Nothing left to do.
+        return;
+    }
+    noop_words_ += noop_words;
+    feed_words_ += feed_words;
+    const bool changed = noop_words + feed_words > 0;
+
+    const float from_z = position_[Z];
+    const bool from_z_known = known_[Z];
+    for (int a = 0; a < AXES; ++a) {
+        if (const Line::Word *w = line->Find(kAxisLetter[a])) {
+            position_[a] = w->value;
+            known_[a] = !relative_[a];
+        }
+    }
+    moved_since_sync_ = true;
+    const bool sideways = line->Find('X') || line->Find('Y');
+
+    if (held_kind_ == HELD_LIFT && sideways && known_[Z]
+        && position_[Z] == from_z) {
+        // Straight up only as far as needed, the rest on the way.
+        Line lift;
+        Parse(held_[0].data(), held_[0].size(), &lift);
+        const Line::Word &z_word = *lift.Find('Z');
+        char straight_up[64];
+        snprintf(straight_up, sizeof(straight_up), "%.*s Z%.3f",
+                 (int)lift.words[0].len, lift.words[0].text, held_lift_z_);
+        std::string first = straight_up;
+        if (const Line::Word *f = lift.Find('F')) {
+            first.append(" ");   // Lift at its speed, travel at its own.
+            first.append(f->text, f->len);
+        }
+        if (lift.comment) {
+            first.append(" ");
+            first.append(lift.comment, lift.comment_len);
+        }
+        Emit(first);
+        for (size_t i = 1; i < held_.size(); ++i) Emit(held_[i]);
+        if (!line->Find('Z')) {
+            // Goes after x/y, like in the templates.
+            size_t pos = 1;
+            while (pos < line->words.size()
+                   && (line->words[pos].letter == 'X'
+                       || line->words[pos].letter == 'Y')) ++pos;
+            line->words.insert(line->words.begin() + pos, z_word);
+        }
+        Emit(Assemble(*line));
+        held_.clear();
+        held_kind_ = HELD_NONE;
+        ++lifts_split_;
+        return;
+    }
+    EmitHeld();
+
+    const std::string assembled = changed ? Assemble(*line) : std::string();
+    const char *out = changed ? assembled.data() : text;
+    const size_t out_len = changed ? assembled.size() : len;
+    const bool only_z = line->Find('Z')
+        && line->words.size() == (line->Find('F') ? 3u : 2u);
+    // Only lifts the emitter says how far they have to go straight up.
+    float safe_lift;
+    if ((rewrites_ & REWRITE_LIFT) && only_z && from_z_known && known_[Z]
+        && line->comment
+        && GCodeSimulator::FindSafeLift(line->comment, line->comment_len,
+                                        &safe_lift)) {
+        const float lift_z = std::max(from_z + machine_.clearance, safe_lift);
+        if (position_[Z] > lift_z) {
+            held_lift_z_ = lift_z;
+            Hold(HELD_LIFT, out, out_len);
+            return;
+        }
+    }
+    Emit(out, out_len);
+}
+
+void GCodePeephole::Dwell(const char *text, size_t len, const Line &line) {
+    float ms = 0;
+    if (const Line::Word *p = line.Find('P')) ms += p->value;
+    if (const Line::Word *s = line.Find('S')) ms += s->value * 1000;
+    const bool was_moving = moved_since_sync_;
+    moved_since_sync_ = false;
+    if (!(rewrites_ & REWRITE_DWELL)) {
+        EmitHeld();
+        Emit(text, len);
+        return;
+    }
+    if (ms == 0 && !was_moving) {
+        ++dwells_dropped_;   // Nothing to wait for.
+        return;
+    }
+    if (held_kind_ == HELD_DWELL) {
+        if (held_dwell_ms_ == 0) {
+            held_[0].assign(text, len);
+        } else if (ms > 0) {
+            char merged[64];
+            snprintf(merged, sizeof(merged), "G4 P%d",
+                     (int)(held_dwell_ms_ + ms));
+            held_[0] = merged;
+        }
+        held_dwell_ms_ += ms;
+        ++dwells_merged_;
+        return;
+    }
+    EmitHeld();
+    held_dwell_ms_ = ms;
+    Hold(HELD_DWELL, text, len);
+}
+
+void GCodePeephole::SetPin(const char *text, size_t len, const Line &line) {
+    EmitHeld();
+    const Line::Word *p = line.Find('P');
+    const Line::Word *s = line.Find('S');
+    if (p == NULL || s == NULL || p->value < 0) {
+        Emit(text, len);
+        return;
+    }
+    const size_t pin = p->value;
+    const int value = s->value;
+    if (pin >= pins_.size()) pins_.resize(pin + 1, -1);
+    if ((rewrites_ & REWRITE_NOOP) && pins_[pin] == value) {
+        ++noop_lines_;
+        return;
+    }
+    pins_[pin] = value;
+    Emit(text, len);
+}
+
+void GCodePeephole::Emit(const char *text, size_t len) {
+    out_.Append(text, len);
+    out_.Append("\n", 1);
+    time_out_.ProcessLine(text, len);
+}
+
+void GCodePeephole::Hold(HeldKind kind, const char *text, size_t len) {
+    held_kind_ = kind;
+    held_.push_back(std::string(text, len));
+}
+
+void GCodePeephole::EmitHeld() {
+    for (const std::string &line : held_) Emit(line);
+    held_.clear();
+    held_kind_ = HELD_NONE;
+}
+
+void GCodePeephole::PrintReport(FILE *out) const {
+    fprintf(out, "G-code rewrites: %d lines before, %d after. "
+            "lift: %d split; noop: %d lines, %d words; feed: %d words; "
+            "dwell: %d dropped, %d merged.\n",
+            time_in_.lines(), time_out_.lines(), lifts_split_,
+            noop_lines_, noop_words_, feed_words_,
+            dwells_dropped_, dwells_merged_);
+    fprintf(out, "Estimated G-code time: %.1fs before rewrites, %.1fs "
+            "after (%.1fs saved).\n", time_in_.seconds(), time_out_.seconds(),
+            time_in_.seconds() - time_out_.seconds());
+}
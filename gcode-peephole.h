@@ -0,0 +1,126 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Peephole optimization of G-code on its way out: rewrites that the
+ * fixed templates can't know about, such as words repeating what the
+ * machine already does or dwells that have nothing to wait for.
+ */
+#ifndef PNP_GCODE_PEEPHOLE_H
+#define PNP_GCODE_PEEPHOLE_H
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "gcode-simulator.h"
+#include "machine-model.h"
+#include "output-buffer.h"
+
+class GCodePeephole : public OutputFilter {
+public:
+    enum Rewrite {
+        // Z-only lift followed by travel at that height: go straight up only
+        // by the machine's clearance, but at least to the safe-lift= the
+        // emitter marked it with, then travel while lifting the rest.
+        // Unmarked lifts stay as they are.
+        REWRITE_LIFT  = 1 << 0,
+        // Drop axis words that don't move the axis, moves that don't move
+        // anything and M42 setting a pin to what it already is. Axes are
+        // only tracked in absolute mode; E not across a tool change (T)
+        // until G92 sets it, none after G-codes not modeled here.
+        REWRITE_NOOP  = 1 << 1,
+        // Drop feedrates that are already in effect.
+        REWRITE_FEED  = 1 << 2,
+        // Drop G4 that has nothing to wait for, merge consecutive dwells.
+        REWRITE_DWELL = 1 << 3,
+        REWRITE_ALL   = (1 << 4) - 1,
+    };
+
+    // Parse a comma separated list of rewrites "lift,noop,feed,dwell" or
+    // "all". Returns the bits or -1 if there is something unknown.
+    static int ParseRewrites(const char *list);
+
+    // Write rewritten G-code to "out". "machine" gives the clearance and is
+    // used to estimate the time saved.
+    GCodePeephole(FILE *out, const MachineModel &machine, int rewrites);
+
+    void Write(const char *data, size_t len) override;
+
+    // Write out what is held back waiting for the next line.
+    void Finish();
+
+    // What has been written, after the rewrites.
+    const OutputBuffer &output() const { return out_; }
+
+    // Lines and estimated time saved, per rewrite.
+    void PrintReport(FILE *out) const;
+
+private:
+    // Parsed G-code line. Words point into the line.
+    struct Line {
+        char command;
+        int code;
+        struct Word {
+            char letter;
+            float value;
+            const char *text;
+            size_t len;
+        };
+        std::vector<Word> words;
+        const char *comment;   // NULL if there is none.
+        size_t comment_len;
+
+        const Word *Find(char letter) const;
+        void Remove(char letter);
+    };
+    enum { X, Y, Z, E, AXES };   // Index into position_.
+    enum HeldKind { HELD_NONE, HELD_LIFT, HELD_DWELL };
+
+    void ProcessLine(const char *text, size_t len);
+    bool Parse(const char *text, size_t len, Line *line) const;
+    void Move(const char *text, size_t len, Line *line);
+    void Dwell(const char *text, size_t len, const Line &line);
+    void SetPin(const char *text, size_t len, const Line &line);
+
+    // Positions are not known anymore, e.g. after a command that isn't
+    // modeled here.
+    void Forget();
+
+    // Assemble a line from its (remaining) words.
+    static std::string Assemble(const Line &line);
+
+    void Emit(const char *text, size_t len);
+    void Emit(const std::string &text) { Emit(text.data(), text.size()); }
+    void Hold(HeldKind kind, const char *text, size_t len);
+    void EmitHeld();
+
+    OutputBuffer out_;
+    const MachineModel &machine_;
+    const int rewrites_;
+    std::string partial_;   // Incomplete line from last Write().
+
+    // Machine state after the lines seen so far.
+    float position_[AXES];
+    bool known_[AXES];
+    bool relative_[AXES];   // G91, M83: not tracked.
+    float feed_;            // 0 if not known.
+    std::vector<int> pins_; // -1 if not known.
+    bool moved_since_sync_;
+
+    // A line waiting for the next command to decide if it can be rewritten,
+    // followed by comments and empty lines seen since.
+    HeldKind held_kind_;
+    std::vector<std::string> held_;
+    float held_lift_z_;     // HELD_LIFT: how far straight up.
+    float held_dwell_ms_;   // HELD_DWELL: how long.
+
+    GCodeSimulator time_in_;
+    GCodeSimulator time_out_;
+    int lifts_split_;
+    int noop_lines_, noop_words_;
+    int feed_words_;
+    int dwells_dropped_, dwells_merged_;
+};
+
+#endif  // PNP_GCODE_PEEPHOLE_H
@@ -8,26 +8,20 @@
 #include <stdio.h>
 #include <math.h>
 
-#include "tape.h"
-#include "pnp-config.h"
-
-// Hovering while transporting a component.
-#define Z_HOVERING 10
+#include <algorithm>
+#include <thread>
 
-// Placement needs to be a bit higher.
-//#define TAPE_TO_BOARD_DIFFZ 1.6
-#define TAPE_TO_BOARD_DIFFZ -2.0
-
-// All templates should be in a separate file somewhere so that we don't
-// have to compile.
+#include "feeder.h"
+#include "pnp-config.h"
 
-// Multiplication to get 360 degrees mapped to one turn.
-#define ANGLE_FACTOR (50.34965 / 360)
+// Built-in templates; others can be loaded with LoadTemplates(), see
+// templates/ for examples and gcode-template.h for the placeholders.
 
 const char *const gcode_preamble = R"(
 ; Preamble. Fill be whatever is necessary to init.
-; Assumes an 'A' axis that rotates the pick'n place nozzle. The values
-; 0..360 correspond to absolute degrees.
+; Assumes an 'A' axis that rotates the pick'n place nozzle, in degrees.
+; Each part turns it the short way from where it is, so the values add up
+; and are not limited to 0..360.
 ; (correction: for now, we mess with an E-axis instead of A)
 G28 X0 Y0  ; Now home (x/y) - needle over free space
 G28 Z0     ; Now it is safe to home z
@@ -38,82 +32,472 @@ G92 E0
 G1 Z35 E0 F2500 ; Move needle out of way
 )";
 
-// param: name, x, y, zup, zdown, a, zup
 const char *const pick_gcode = R"(
-; Pick %s
-G1 X%.3f Y%.3f Z%.3f E%.3f ; Move over component to pick.
-G1 Z%.3f   ; move down
+; Pick {name} ({key})
+G1 X{x} Y{y} Z{zup} E{e} ; Move over component to pick.
+G1 Z{zdown}   ; move down
 G4
-M42 P6 S255  ; turn on suckage
-G1 Z%.3f  ; Move up a bit for traveling
+M42 P{vacuum-pin} S255  ; turn on suckage
+G1 Z{zretract}  ; Move up a bit for traveling, safe-lift={zlift}
 )";
 
-// param: name, x, y, zup, a, zdown, zup
 const char *const place_gcode = R"(
-; Place %s
-G1 X%.3f Y%.3f Z%.3f E%.3f ; Move over component to place.
-G1 Z%.3f    ; move down.
+; Place {name} ({key})
+G1 X{x} Y{y} Z{zup} E{e} ; Move over component to place.
+G1 Z{zdown}    ; move down.
+G4
+M42 P{vacuum-pin} S0    ; turn off suckage
+G4
+M42 P{blow-pin} S255  ; blow
+G4 P{blow-ms}      ; .. for {blow-ms}ms
+M42 P{blow-pin} S0    ; done.
+G1 Z{zretract}   ; Move up, safe-lift={zlift}
+)";
+
+// With an approach speed in the Machine: section: travel with G0 at full
+// speed, go down fast to just above contact, and the rest slowly; same way
+// back up.
+const char *const pick_approach_gcode = R"(
+; Pick {name} ({key})
+G0 X{x} Y{y} Z{zup} E{e} F{travel-feed} ; Move over component to pick.
+G0 Z{znear} F{z-feed} ; move down
+G1 Z{zdown} F{approach-feed} ; .. slowly the last bit
 G4
-M42 P6 S0    ; turn off suckage
+M42 P{vacuum-pin} S255  ; turn on suckage
+G1 Z{zretract-near} F{approach-feed} ; slowly off
+G0 Z{zretract} F{z-feed} ; Move up a bit for traveling, safe-lift={zlift}
+)";
+
+const char *const place_approach_gcode = R"(
+; Place {name} ({key})
+G0 X{x} Y{y} Z{zup} E{e} F{travel-feed} ; Move over component to place.
+G0 Z{znear} F{z-feed} ; move down
+G1 Z{zdown} F{approach-feed} ; .. slowly the last bit
 G4
-M42 P8 S255  ; blow
-G4 P100      ; .. for 100ms
-M42 P8 S0    ; done.
-G1 Z%.3f   ; Move up
+M42 P{vacuum-pin} S0    ; turn off suckage
+G4
+M42 P{blow-pin} S255  ; blow
+G4 P{blow-ms}      ; .. for {blow-ms}ms
+M42 P{blow-pin} S0    ; done.
+G1 Z{zretract-near} F{approach-feed} ; slowly off
+G0 Z{zretract} F{z-feed} ; Move up, safe-lift={zlift}
+)";
+
+const char *const select_nozzle_gcode = R"(
+T{tool}        ; Select nozzle
+G92 E{e}
+)";
+
+const char *const finish_gcode = R"(
+M84 ; done.
 )";
 
-GCodePickNPlace::GCodePickNPlace(const PnPConfig *config) : config_(config) {
+// Moves formatted per thread at a time; keeps memory bounded on huge boards.
+static const int kMovesPerThread = 8192;
+
+// LiftZ() looks at the travel in pieces of this length, but at most this
+// many.
+static const float kLiftStep = 2.0;
+static const int kLiftSegments = 64;
+
+GCodePickNPlace::GCodePickNPlace(const PnPConfig *config, int threads,
+                                 FILE *out)
+    : Printer(out), config_(config), threads_(std::max(1, threads)),
+      machine_values_(MachineValues()), scheduler_(*config),
+      nozzle_angle_(config->machine.nozzles.size(), 0), current_nozzle_(0),
+      board_added_(false), highest_pick_(0) {
     assert(config_);
+    const uint32_t all = GCodeTemplate::kAllFields;
+    const uint32_t machine_only = all & ~GCodeTemplate::kMoveFields;
+    std::string error;
+    bool ok = templates_.preamble.Compile(gcode_preamble, machine_only, &error)
+        && templates_.pick.Compile(pick_gcode, all, &error)
+        && templates_.place.Compile(place_gcode, all, &error)
+        && templates_.pick_approach.Compile(pick_approach_gcode, all, &error)
+        && templates_.place_approach.Compile(place_approach_gcode, all,
+                                             &error)
+        && templates_.select_nozzle.Compile(select_nozzle_gcode, all, &error)
+        && templates_.finish.Compile(finish_gcode, machine_only, &error);
+    assert(ok);   // Built-in templates are fine.
+    (void) ok;
 #if 0
     fprintf(stderr, "Board-origin: (%.3f, %.3f)\n",
             config_->board_origin.x, config_->board_origin.y);
     for (const auto &t : config_->tape_for_component) {
-        fprintf(stderr, "%s\t", t.first.c_str());
-        t.second->DebugPrint();
-        fprintf(stderr, "\n");
+        for (const Feeder *tape : t.second) {
+            fprintf(stderr, "%s\t", t.first.c_str());
+            tape->DebugPrint();
+            fprintf(stderr, "\n");
+        }
     }
 #endif
 }
 
+bool GCodePickNPlace::LoadTemplates(const char *filename) {
+    if (!templates_.Load(filename))
+        return false;
+    // Otherwise, all parts would be placed by the first nozzle, with the
+    // offsets of the others.
+    const size_t nozzles = config_->machine.nozzles.size();
+    if (nozzles > 1
+        && !templates_.select_nozzle.Uses(GCodeTemplate::TOOL)) {
+        fprintf(stderr, "%s: [select-nozzle] doesn't use {tool}, but there "
+                "are %zu nozzles.\n", filename, nozzles);
+        return false;
+    }
+    // The planner and the estimates count on the slow approach.
+    if (config_->machine.approach_speed > 0
+        && (!templates_.pick_approach.Uses(GCodeTemplate::APPROACH_FEED)
+            || !templates_.place_approach.Uses(GCodeTemplate::APPROACH_FEED))) {
+        fprintf(stderr, "%s: pick and place don't use {approach-feed}, but "
+                "the config has an approach-speed.\n", filename);
+        return false;
+    }
+    return true;
+}
+
 void GCodePickNPlace::Init(const Dimension& dim) {
-    printf("%s", gcode_preamble);
+    templates_.preamble.Expand(machine_values_, &out_);
+    std::fill(nozzle_angle_.begin(), nozzle_angle_.end(), 0);
+    current_nozzle_ = 0;   // Preamble selects T1.
+
+    const size_t nozzles = config_->machine.nozzles.size();
+    obstacles_.Clear();
+    board_size_ = dim;
+    board_added_ = false;
+    head_ = Position(0, 0);   // Homed.
+    carried_height_.assign(nozzles, 0);
+    carried_reach_.assign(nozzles, 0);
+    highest_pick_ = 0;
+    for (const auto &t : config_->tape_for_component) {
+        for (const Feeder *tape : t.second)
+            highest_pick_ = std::max(highest_pick_, tape->height());
+    }
+    if (config_->machine.hover_margin <= 0)
+        return;
+    // Components still on the feeders stick out as high as the first.
+    for (const auto &t : config_->tape_for_component) {
+        for (const Feeder *tape : t.second) {
+            if (tape->capacity() <= 0) continue;
+            Box box;
+            box.p0 = box.p1 = tape->PositionOf(0);
+            for (int i = 1; i < tape->capacity(); ++i) {
+                const Position pos = tape->PositionOf(i);
+                box.p0.x = std::min(box.p0.x, pos.x);
+                box.p0.y = std::min(box.p0.y, pos.y);
+                box.p1.x = std::max(box.p1.x, pos.x);
+                box.p1.y = std::max(box.p1.y, pos.y);
+            }
+            obstacles_.Add(box, tape->height());
+        }
+    }
+}
+
+void GCodePickNPlace::SelectNozzle(int nozzle) {
+    if (nozzle == current_nozzle_)
+        return;
+    // All nozzles rotate with the E axis, so tell it where this one is.
+    Move move = Move();
+    move.kind = Move::SELECT_NOZZLE;
+    move.nozzle = nozzle;
+    move.angle = nozzle_angle_[nozzle];
+    move.e = config_->machine.e_per_degree * move.angle;
+    AddMove(move);
+    current_nozzle_ = nozzle;
+}
+
+void GCodePickNPlace::RotateTo(int nozzle, float angle, Move *move) {
+    float &current = nozzle_angle_[nozzle];
+    current += ShortestRotation(current, angle);
+    move->angle = current;
+    move->e = config_->machine.e_per_degree * current;
 }
 
 void GCodePickNPlace::PrintPart(const Part &part) {
-    const std::string key = part.footprint + "@" + part.value;
-    auto found = config_->tape_for_component.find(key);
-    if (found == config_->tape_for_component.end()) {
-        fprintf(stderr, "No tape for '%s'\n", key.c_str());
+    Feeder *tape = NULL;
+    if (!config_->tape_for_part.empty()) {
+        tape = config_->tape_for_part[part.index];
+    } else if (part.component_key_id < (int)config_->tapes_for_key.size()) {
+        // Not planned: first tape that still has components.
+        for (Feeder *t : config_->tapes_for_key[part.component_key_id]) {
+            tape = t;
+            if (t->count() > 0) break;
+        }
+    }
+    if (tape == NULL) {
+        fprintf(stderr, "No tape for '%s'\n", part.component_key);
+        return;
+    }
+    const int pending = std::count(batch_tapes_.begin(), batch_tapes_.end(),
+                                   tape);
+    if (tape->count() <= pending) {
+        fprintf(stderr, "We are out of components for '%s'\n",
+                part.component_key);
         return;
     }
-    Tape *tape = found->second;
-    float px, py, pz;
-    if (!tape->GetPos(&px, &py, &pz)) {
-        fprintf(stderr, "We are out of components for '%s'\n", key.c_str());
+    batch_.push_back(part);
+    batch_tapes_.push_back(tape);
+    if (batch_.size() == config_->machine.nozzles.size())
+        PrintBatch();
+}
+
+void GCodePickNPlace::PrintBatch() {
+    if (batch_.empty())
         return;
+    std::vector<BatchScheduler::Step> steps;
+    std::vector<int> next;
+    for (const Feeder *tape : batch_tapes_) next.push_back(tape->consumed());
+    scheduler_.Schedule(batch_,
+                        std::vector<const Feeder*>(batch_tapes_.begin(),
+                                                   batch_tapes_.end()),
+                        next, &steps);
+    const MachineModel &machine = config_->machine;
+    std::vector<float> pick_z(batch_.size());
+    for (const BatchScheduler::Step &step : steps) {
+        const Part &part = batch_[step.slot];
+        Feeder *tape = batch_tapes_[step.slot];
+        const Nozzle &nozzle = machine.nozzles[step.slot];
+        SelectNozzle(step.slot);
+        Move move;
+        move.nozzle = step.slot;
+        move.name = part.component_name;
+        move.key = part.component_key;
+        float pz;
+        if (step.pick) {
+            float px, py;
+            tape->GetPos(&px, &py, &pz);
+            tape->Advance();
+            pick_z[step.slot] = pz;
+            move.kind = Move::PICK;
+            move.x = px - nozzle.offset.x;   // component position.
+            move.y = py - nozzle.offset.y;
+            RotateTo(step.slot, tape->angle(), &move);   // pickup angle
+            move.z_down = pz;   // down to component
+        } else {
+            pz = pick_z[step.slot];
+            // TODO: right now, we are assuming the z is the same height as
+            move.kind = Move::PLACE;
+            move.x = part.pos.x + config_->board.origin.x - nozzle.offset.x;
+            move.y = part.pos.y + config_->board.origin.y - nozzle.offset.y;
+            RotateTo(step.slot, part.angle - tape->angle(), &move);
+            move.z_down = pz + machine.board_z;
+        }
+        const Position head(move.x, move.y);
+        move.z_up = TravelZ(head, move.z_down, pz);
+        move.z_near = std::min(move.z_down + machine.approach_height,
+                               move.z_up);
+        move.z_retract = move.z_up;
+        move.z_lift = move.z_retract;
+        AddMove(move);
+        head_ = head;
+
+        // What the nozzle carries from now on.
+        if (step.pick) {
+            const Box &box = part.bounding_box;
+            carried_height_[step.slot]
+                = config_->height_for_key[part.component_key_id];
+            carried_reach_[step.slot] = std::max(
+                std::max(fabsf(box.p0.x), fabsf(box.p1.x)),
+                std::max(fabsf(box.p0.y), fabsf(box.p1.y)));
+            continue;
+        }
+        const float height = carried_height_[step.slot];
+        carried_height_[step.slot] = 0;
+        carried_reach_[step.slot] = 0;
+        if (machine.hover_margin <= 0)
+            continue;
+        // Where the part is now.
+        const float x = move.x + nozzle.offset.x;
+        const float y = move.y + nozzle.offset.y;
+        Box box = part.bounding_box;
+        box.p0.x += x; box.p0.y += y;
+        box.p1.x += x; box.p1.y += y;
+        obstacles_.Add(box, move.z_down);   // Nozzle was on top of it.
+        if (!board_added_ && height >= 0) {
+            // Now we know where the board surface is.
+            Box board;
+            board.p0 = config_->board.origin;
+            board.p1 = Position(board.p0.x + board_size_.w,
+                                board.p0.y + board_size_.h);
+            obstacles_.Add(board, move.z_down - height);
+            board_added_ = true;
+        }
+    }
+    batch_.clear();
+    batch_tapes_.clear();
+}
+
+float GCodePickNPlace::TravelZ(const Position &to, float z_down,
+                               float pick_z) const {
+    const MachineModel &machine = config_->machine;
+    const float hover = pick_z + machine.hover;
+    if (machine.hover_margin <= 0)
+        return hover;
+    float z = z_down;
+    for (size_t n = 0; n < machine.nozzles.size(); ++n) {
+        if (carried_height_[n] < 0)
+            return hover;   // Don't know how far it hangs down.
+        const Position &offset = machine.nozzles[n].offset;
+        const float top = obstacles_.MaxAlong(
+            Position(head_.x + offset.x, head_.y + offset.y),
+            Position(to.x + offset.x, to.y + offset.y),
+            carried_reach_[n] + machine.hover_margin, z_down);
+        z = std::max(z, top + carried_height_[n]);
+    }
+    return std::min(z + machine.hover_margin, hover);
+}
+
+float GCodePickNPlace::LiftZ(const Position &from, float z_from,
+                             const Position &to, float z_to) const {
+    const MachineModel &machine = config_->machine;
+    if (machine.hover_margin <= 0) {
+        // All we know is that nothing is higher than the highest pick-up
+        // (or, on the board, that plus board-z), so clear that with what
+        // hangs below the nozzles.
+        float carried = 0;
+        for (float height : carried_height_) {
+            if (height < 0)
+                return z_to;
+            carried = std::max(carried, height);
+        }
+        const float top = highest_pick_ + std::max(0.0f, machine.board_z);
+        return std::min(std::max(top + carried + machine.clearance, z_from),
+                        z_to);
+    }
+    // Going from segment to segment, the lowest the head is in each is at
+    // its start. The lift has to be high enough that it is above what is
+    // in each segment there.
+    const int segments = std::max(1, std::min(
+        kLiftSegments, (int) ceilf(Distance(from, to) / kLiftStep)));
+    float lift = z_from;
+    for (int i = 0; i < segments && lift < z_to; ++i) {
+        const float t0 = (float) i / segments;
+        const float t1 = (float) (i + 1) / segments;
+        float need = z_from;
+        for (size_t n = 0; n < machine.nozzles.size(); ++n) {
+            if (carried_height_[n] < 0)
+                return z_to;
+            const Position &offset = machine.nozzles[n].offset;
+            const float top = obstacles_.MaxAlong(
+                Position(from.x + t0 * (to.x - from.x) + offset.x,
+                         from.y + t0 * (to.y - from.y) + offset.y),
+                Position(from.x + t1 * (to.x - from.x) + offset.x,
+                         from.y + t1 * (to.y - from.y) + offset.y),
+                carried_reach_[n] + machine.hover_margin, z_from);
+            need = std::max(need, top + carried_height_[n]);
+        }
+        need += machine.hover_margin;
+        // Head at t0: lift + t0 * (z_to - lift) >= need.
+        lift = std::max(lift, (need - t0 * z_to) / (1 - t0));
+    }
+    return std::min(lift, z_to);
+}
+
+void GCodePickNPlace::AddMove(const Move &move) {
+    if (move.kind != Move::SELECT_NOZZLE && !lookahead_.empty()) {
+        // First one is the last pick or place. With a hover margin, it
+        // goes back up to where this one travels.
+        Move &last = lookahead_[0];
+        if (config_->machine.hover_margin > 0)
+            last.z_retract = move.z_up;
+        if (last.z_retract == move.z_up) {
+            last.z_lift = LiftZ(Position(last.x, last.y), last.z_down,
+                                Position(move.x, move.y), move.z_up);
+        }
+        for (const Move &m : lookahead_) QueueMove(m);
+        lookahead_.clear();
+    }
+    if (move.kind == Move::SELECT_NOZZLE && lookahead_.empty())
+        QueueMove(move);   // Nothing to wait for.
+    else
+        lookahead_.push_back(move);
+}
+
+void GCodePickNPlace::QueueMove(const Move &move) {
+    if (threads_ == 1) {
+        FormatMove(move, &out_);
+        return;
+    }
+    pending_moves_.push_back(move);
+    if ((int)pending_moves_.size() >= threads_ * kMovesPerThread)
+        FormatPendingMoves();
+}
+
+GCodeTemplate::Values GCodePickNPlace::MachineValues() const {
+    const MachineModel &machine = config_->machine;
+    GCodeTemplate::Values values;
+    values.number[GCodeTemplate::BLOW_MS] = (int) machine.blow_ms;
+    // Feedrates are mm/min.
+    values.number[GCodeTemplate::TRAVEL_FEED] = roundf(machine.xy_speed * 60);
+    values.number[GCodeTemplate::Z_FEED] = roundf(machine.z_speed * 60);
+    values.number[GCodeTemplate::APPROACH_FEED]
+        = roundf((machine.approach_speed > 0 ? machine.approach_speed
+                  : machine.z_speed) * 60);
+    return values;
+}
+
+void GCodePickNPlace::FormatMove(const Move &move, OutputBuffer *out) const {
+    const Nozzle &nozzle = config_->machine.nozzles[move.nozzle];
+    GCodeTemplate::Values values = machine_values_;
+    values.number[GCodeTemplate::TOOL] = move.nozzle + 1;
+    values.number[GCodeTemplate::ANGLE] = move.angle;
+    values.number[GCodeTemplate::E] = move.e;
+    if (move.kind == Move::SELECT_NOZZLE) {
+        templates_.select_nozzle.Expand(values, out);
+        return;
+    }
+    values.text[GCodeTemplate::NAME] = move.name;
+    values.text[GCodeTemplate::KEY] = move.key;
+    values.number[GCodeTemplate::X] = move.x;
+    values.number[GCodeTemplate::Y] = move.y;
+    values.number[GCodeTemplate::Z_UP] = move.z_up;
+    values.number[GCodeTemplate::Z_DOWN] = move.z_down;
+    values.number[GCodeTemplate::Z_NEAR] = move.z_near;
+    values.number[GCodeTemplate::Z_RETRACT] = move.z_retract;
+    values.number[GCodeTemplate::Z_RETRACT_NEAR]
+        = std::min(move.z_near, move.z_retract);
+    values.number[GCodeTemplate::Z_LIFT] = move.z_lift;
+    values.number[GCodeTemplate::VACUUM_PIN] = nozzle.vacuum_pin;
+    values.number[GCodeTemplate::BLOW_PIN] = nozzle.blow_pin;
+    const bool approach = config_->machine.approach_speed > 0;
+    if (move.kind == Move::PICK)
+        (approach ? templates_.pick_approach : templates_.pick)
+            .Expand(values, out);
+    else
+        (approach ? templates_.place_approach : templates_.place)
+            .Expand(values, out);
+}
+
+void GCodePickNPlace::FormatPendingMoves() {
+    if (pending_moves_.empty())
+        return;
+    // Contiguous ranges per thread, each into its own buffer, then written
+    // in order.
+    const int count = pending_moves_.size();
+    std::vector<OutputBuffer*> chunks;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads_; ++t) {
+        const int begin = (long)count * t / threads_;
+        const int end = (long)count * (t + 1) / threads_;
+        OutputBuffer *chunk = new OutputBuffer(NULL, 1 << 16);
+        chunks.push_back(chunk);
+        workers.push_back(std::thread([this, begin, end, chunk]() {
+            for (int i = begin; i < end; ++i)
+                FormatMove(pending_moves_[i], chunk);
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); ++t) {
+        workers[t].join();
+        out_.Append(*chunks[t]);
+        delete chunks[t];
     }
-    tape->Advance();
-
-    const std::string print_name = part.component_name + " (" + key + ")";
-    // param: name, x, y, zdown, a, zup
-    printf(pick_gcode,
-           print_name.c_str(),
-           px, py, pz + Z_HOVERING,                  // component pos.
-           ANGLE_FACTOR * fmod(tape->angle(), 360.0),  // pickup angle
-           pz,   // down to component
-           pz + Z_HOVERING);
-
-    // TODO: right now, we are assuming the z is the same height as
-    // param: name, x, y, zup, a, zdown, zup
-    printf(place_gcode,
-           print_name.c_str(),
-           part.pos.x + config_->board.origin.x,
-           part.pos.y + config_->board.origin.y, pz + Z_HOVERING,
-           ANGLE_FACTOR * fmod(part.angle - tape->angle() + 360, 360.0),
-           pz + TAPE_TO_BOARD_DIFFZ,
-           pz + Z_HOVERING);
+    pending_moves_.clear();
 }
 
 void GCodePickNPlace::Finish() {
-    printf("\nM84 ; done.\n");
+    PrintBatch();
+    for (const Move &m : lookahead_) QueueMove(m);
+    lookahead_.clear();
+    FormatPendingMoves();
+    templates_.finish.Expand(machine_values_, &out_);
 }
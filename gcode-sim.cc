@@ -0,0 +1,70 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Command line front end to the GCodeSimulator: validate and time G-code.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gcode-simulator.h"
+#include "pnp-config.h"
+
+static int usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-c <config>] [<gcode-file>]\n"
+            "Simulate G-code from rpt2pnp: estimate time, count picks and\n"
+            "places and report problems. Reads stdin without file.\n"
+            "Options:\n"
+            "\t-c <config> : Configuration as used with rpt2pnp -c. Gives\n"
+            "\t          the Machine: parameters; picks are checked\n"
+            "\t          against the tapes.\n"
+            "Exit code is 2 if there are violations.\n", prog);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    const char *config_filename = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:")) != -1) {
+        switch (opt) {
+        case 'c':
+            config_filename = optarg;
+            break;
+        default:
+            return usage(argv[0]);
+        }
+    }
+
+    PnPConfig *config = NULL;
+    if (config_filename) {
+        config = ParsePnPConfiguration(config_filename);
+        if (config == NULL)
+            return 1;
+    }
+    const MachineModel machine = config ? config->machine : MachineModel();
+
+    FILE *in = stdin;
+    if (optind < argc) {
+        in = fopen(argv[optind], "r");
+        if (in == NULL) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    GCodeSimulator simulator(machine, config);
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+    while ((len = getline(&line, &capacity, in)) >= 0) {
+        if (len > 0 && line[len - 1] == '\n') --len;
+        simulator.ProcessLine(line, len);
+    }
+    free(line);
+    if (in != stdin) fclose(in);
+
+    simulator.Finish();
+    simulator.PrintReport(stdout);
+    return simulator.violations() > 0 ? 2 : 0;
+}
@@ -0,0 +1,282 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "gcode-simulator.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "feeder.h"
+#include "number-parser.h"
+#include "pnp-config.h"
+
+// How close a pick needs to be to a component on a tape.
+static const float kPickTolerance = 0.05;
+
+// Only that many violations are printed; all are counted.
+static const int kMaxReported = 100;
+
+// Coordinates are written with three decimals.
+static const float kRounding = 0.0005;
+
+GCodeSimulator::GCodeSimulator(const MachineModel &machine,
+                               const PnPConfig *config, FILE *violation_out)
+    : machine_(machine), violation_out_(violation_out), line_(0),
+      x_(0), y_(0), z_(0), e_(0), feed_(0),
+      nozzle_(0), vacuum_(machine.nozzles.size(), false), safe_lift_(NAN),
+      picks_(0), places_(0), unknown_(0), violations_(0),
+      travel_(0), seconds_(0) {
+    if (config == NULL)
+        return;
+    for (const auto &component : config->tape_for_component) {
+        for (const Feeder *tape : component.second) {
+            if (std::find(tapes_.begin(), tapes_.end(), tape)
+                != tapes_.end()) continue;   // shared tape.
+            tapes_.push_back(tape);
+            taken_.push_back(tape->consumed());
+        }
+    }
+}
+
+void GCodeSimulator::Violation(const char *format, ...) {
+    if (++violations_ > kMaxReported || violation_out_ == NULL)
+        return;
+    fprintf(violation_out_, "line %d: ", line_);
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(violation_out_, format, ap);
+    va_end(ap);
+    fprintf(violation_out_, "\n");
+}
+
+void GCodeSimulator::ProcessLine(const char *line, size_t len) {
+    ++line_;
+    const char *end = line + len;
+    const char *comment = (const char*) memchr(line, ';', len);
+    if (comment) end = comment;
+
+    // Command letter and number, followed by parameters.
+    char command = 0;
+    int code = -1;
+    Words w;
+    std::fill(w.has, w.has + 26, false);
+    const char *pos = line;
+    while (pos < end) {
+        if (isspace(*pos)) {
+            ++pos;
+            continue;
+        }
+        const char letter = toupper(*pos++);
+        const char *number = pos;
+        while (pos < end && !isspace(*pos)) ++pos;
+        float value = 0;
+        if (letter < 'A' || letter > 'Z'
+            || (pos > number && !ParseFloat(number, pos - number, &value))) {
+            Violation("Can't parse '%.*s'", (int)(pos - number + 1),
+                      number - 1);
+            return;
+        }
+        if (command == 0) {
+            command = letter;
+            code = value;
+        } else {
+            w.has[letter - 'A'] = true;
+            w.value[letter - 'A'] = value;
+        }
+    }
+    if (command == 0)
+        return;   // Empty line or only comment.
+
+    if (command == 'G' && (code == 0 || code == 1)) {
+        Move(w);
+    } else if (command == 'G' && code == 4) {
+        Dwell(w);
+    } else if (command == 'G' && code == 28) {
+        Home(w);
+    } else if (command == 'G' && code == 92) {
+        SetPosition(w);
+    } else if (command == 'M' && code == 42) {
+        SetPin(w);
+    } else if (command == 'T') {
+        SelectNozzle(code);
+    } else if (command == 'M' && (code == 84 || code == 302)) {
+        // Motors off, allow cold extrusion: nothing to simulate.
+    } else {
+        ++unknown_;
+    }
+    if (comment) {
+        float safe_lift;
+        if (FindSafeLift(comment, line + len - comment, &safe_lift))
+            safe_lift_ = safe_lift;
+    }
+}
+
+bool GCodeSimulator::FindSafeLift(const char *comment, size_t len,
+                                  float *z) {
+    static const char kMarker[] = "safe-lift=";
+    const std::string text(comment, len);
+    const size_t marker = text.find(kMarker);
+    if (marker == std::string::npos)
+        return false;
+    const size_t begin = marker + strlen(kMarker);
+    size_t end = begin;
+    while (end < text.size() && (isdigit(text[end]) || text[end] == '.'
+                                 || text[end] == '-')) ++end;
+    return ParseFloat(text.data() + begin, end - begin, z);
+}
+
+void GCodeSimulator::Move(const Words &w) {
+    if (w.Has('F'))
+        feed_ = w.Get('F') / 60;
+    const float x = w.Has('X') ? w.Get('X') : x_;
+    const float y = w.Has('Y') ? w.Get('Y') : y_;
+    const float z = w.Has('Z') ? w.Get('Z') : z_;
+    const float e = w.Has('E') ? w.Get('E') : e_;
+
+    if (z < machine_.min_z) {
+        Violation("Z %.3f is lower than allowed %.3f", z, machine_.min_z);
+    }
+    if ((x != x_ || y != y_) && !isnan(safe_lift_)) {
+        if (z_ < safe_lift_ - kRounding) {
+            Violation("Travel starts at Z %.3f, below its safe-lift %.3f",
+                      z_, safe_lift_);
+        }
+        safe_lift_ = NAN;
+    }
+    if (machine_.bed.w > 0 && machine_.bed.h > 0
+        && (x < 0 || y < 0 || x > machine_.bed.w || y > machine_.bed.h)) {
+        Violation("Move to %.3f/%.3f outside the bed (%.1f x %.1f)",
+                  x, y, machine_.bed.w, machine_.bed.h);
+    }
+
+    // The feedrate is a limit on top of what the machine can do.
+    const float xy_speed = feed_ > 0
+        ? std::min(feed_, machine_.xy_speed) : machine_.xy_speed;
+    const float z_speed = feed_ > 0
+        ? std::min(feed_, machine_.z_speed) : machine_.z_speed;
+    const float distance = Distance(Position(x_, y_), Position(x, y));
+    const float t_xy = MachineModel::AxisTime(distance, xy_speed,
+                                              machine_.xy_accel);
+    const float t_z = MachineModel::AxisTime(z - z_, z_speed,
+                                             machine_.z_accel);
+    const float t_e = MachineModel::AxisTime((e - e_) / machine_.e_per_degree,
+                                             machine_.rotation_speed,
+                                             machine_.rotation_accel);
+    seconds_ += std::max(t_xy, std::max(t_z, t_e));
+    travel_ += distance;
+    x_ = x; y_ = y; z_ = z; e_ = e;
+}
+
+void GCodeSimulator::Dwell(const Words &w) {
+    if (w.Has('P')) seconds_ += w.Get('P') / 1000;
+    if (w.Has('S')) seconds_ += w.Get('S');
+}
+
+void GCodeSimulator::Home(const Words &w) {
+    // Time for homing depends on where we are and the endstops; not counted.
+    const bool all = !w.Has('X') && !w.Has('Y') && !w.Has('Z');
+    if (all || w.Has('X')) x_ = 0;
+    if (all || w.Has('Y')) y_ = 0;
+    if (all || w.Has('Z')) z_ = 0;
+}
+
+void GCodeSimulator::SetPosition(const Words &w) {
+    if (w.Has('X')) x_ = w.Get('X');
+    if (w.Has('Y')) y_ = w.Get('Y');
+    if (w.Has('Z')) z_ = w.Get('Z');
+    if (w.Has('E')) e_ = w.Get('E');
+}
+
+void GCodeSimulator::SelectNozzle(int tool) {
+    if (tool < 1 || tool > (int)machine_.nozzles.size()) {
+        Violation("There is no nozzle T%d", tool);
+        return;
+    }
+    nozzle_ = tool - 1;
+}
+
+void GCodeSimulator::SetPin(const Words &w) {
+    if (!w.Has('P') || !w.Has('S')) {
+        Violation("M42 needs P and S");
+        return;
+    }
+    const int pin = w.Get('P');
+    const bool on = w.Get('S') > 0;
+    for (size_t n = 0; n < machine_.nozzles.size(); ++n) {
+        const Nozzle &nozzle = machine_.nozzles[n];
+        if (pin == nozzle.vacuum_pin) {
+            if (on == vacuum_[n]) {
+                Violation(on ? "Vacuum of nozzle %d turned on again, "
+                          "without turning it off (no place?)"
+                          : "Vacuum of nozzle %d turned off, but it "
+                          "was not on (no pick?)", (int)n + 1);
+            }
+            if ((int)n != nozzle_) {
+                Violation("Vacuum of nozzle %d switched while nozzle %d "
+                          "is selected", (int)n + 1, nozzle_ + 1);
+            }
+            vacuum_[n] = on;
+            if (on)
+                Pick();
+            else
+                ++places_;
+            return;
+        }
+        if (pin == nozzle.blow_pin && on && vacuum_[n]) {
+            Violation("Blowing on nozzle %d while vacuum is on", (int)n + 1);
+            return;
+        }
+    }
+}
+
+void GCodeSimulator::Pick() {
+    ++picks_;
+    if (tapes_.empty())
+        return;
+    const Nozzle &nozzle = machine_.nozzles[nozzle_];
+    const float x = x_ + nozzle.offset.x;
+    const float y = y_ + nozzle.offset.y;
+    for (size_t t = 0; t < tapes_.size(); ++t) {
+        const Feeder *tape = tapes_[t];
+        if (taken_[t] >= tape->capacity())
+            continue;
+        const Position pos = tape->PositionOf(taken_[t]);
+        if (fabsf(pos.x - x) > kPickTolerance
+            || fabsf(pos.y - y) > kPickTolerance)
+            continue;
+        if (fabsf(tape->height() - z_) > kPickTolerance) {
+            Violation("Picking at Z %.3f, but component is at %.3f",
+                      z_, tape->height());
+        }
+        ++taken_[t];
+        return;
+    }
+    Violation("Pick at %.3f/%.3f, but there is no component (tape used up?)",
+              x, y);
+}
+
+void GCodeSimulator::Finish() {
+    for (size_t n = 0; n < vacuum_.size(); ++n) {
+        if (vacuum_[n])
+            Violation("Job ends with vacuum of nozzle %d on", (int)n + 1);
+    }
+}
+
+void GCodeSimulator::PrintReport(FILE *out) const {
+    const int seconds = roundf(seconds_);
+    fprintf(out, "Lines:      %d\n", line_);
+    fprintf(out, "Picks:      %d\n", picks_);
+    fprintf(out, "Places:     %d\n", places_);
+    fprintf(out, "XY travel:  %.1fmm\n", travel_);
+    fprintf(out, "Time:       %d:%02d:%02d (%.1fs; homing not counted)\n",
+            seconds / 3600, seconds / 60 % 60, seconds % 60, seconds_);
+    if (unknown_)
+        fprintf(out, "Ignored:    %d commands not simulated\n", unknown_);
+    fprintf(out, "Violations: %d\n", violations_);
+}
@@ -0,0 +1,84 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Simulator for the G-code rpt2pnp emits: follows the machine state line
+ * by line, estimates the time the job takes, counts picks and places and
+ * complains about things that would go wrong on the real machine.
+ */
+#ifndef PNP_GCODE_SIMULATOR_H
+#define PNP_GCODE_SIMULATOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "machine-model.h"
+
+class Feeder;
+struct PnPConfig;
+
+// Follows G-code line by line.
+class GCodeSimulator {
+public:
+    // "config" is optional; with it, picks are checked against the tapes.
+    // Violations are printed to "violation_out", if not NULL.
+    GCodeSimulator(const MachineModel &machine, const PnPConfig *config,
+                   FILE *violation_out = stderr);
+
+    // Process one line without its newline.
+    void ProcessLine(const char *line, size_t len);
+
+    // Checks at the end of the job.
+    void Finish();
+
+    void PrintReport(FILE *out) const;
+
+    // The "safe-lift=<z>" rpt2pnp writes in the comment of a lift: the
+    // travel after it must not start lower. Returns false if there is none.
+    static bool FindSafeLift(const char *comment, size_t len, float *z);
+
+    int violations() const { return violations_; }
+    int lines() const { return line_; }
+    double seconds() const { return seconds_; }
+
+private:
+    // Parameters of a command: value per letter.
+    struct Words {
+        bool has[26];
+        float value[26];
+        bool Has(char c) const { return has[c - 'A']; }
+        float Get(char c) const { return value[c - 'A']; }
+    };
+
+    void Violation(const char *format, ...)
+        __attribute__((format(printf, 2, 3)));
+
+    void Move(const Words &w);
+    void Dwell(const Words &w);
+    void Home(const Words &w);
+    void SetPosition(const Words &w);
+    void SetPin(const Words &w);
+    void SelectNozzle(int tool);
+    void Pick();
+
+    const MachineModel &machine_;
+    FILE *const violation_out_;
+    int line_;
+    float x_, y_, z_, e_;    // Head position.
+    float feed_;             // mm/s, 0 if not set.
+    int nozzle_;
+    std::vector<bool> vacuum_;   // Per nozzle.
+    float safe_lift_;        // Of the last lift; NAN once traveled.
+
+    std::vector<const Feeder*> tapes_;
+    std::vector<int> taken_;     // Per tape; the originals are not modified.
+
+    int picks_, places_;
+    int unknown_;
+    int violations_;
+    double travel_;
+    double seconds_;
+};
+
+#endif  // PNP_GCODE_SIMULATOR_H
@@ -0,0 +1,200 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "gcode-template.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+
+namespace {
+enum FieldType { TEXT, COORDINATE, INTEGER };
+struct FieldInfo {
+    const char *name;
+    FieldType type;
+};
+// In the order of GCodeTemplate::Field.
+static const FieldInfo kFields[GCodeTemplate::FIELD_COUNT] = {
+    { "name", TEXT },
+    { "key", TEXT },
+    { "x", COORDINATE },
+    { "y", COORDINATE },
+    { "zup", COORDINATE },
+    { "zdown", COORDINATE },
+    { "znear", COORDINATE },
+    { "zretract", COORDINATE },
+    { "zretract-near", COORDINATE },
+    { "zlift", COORDINATE },
+    { "angle", COORDINATE },
+    { "e", COORDINATE },
+    { "tool", INTEGER },
+    { "vacuum-pin", INTEGER },
+    { "blow-pin", INTEGER },
+    { "blow-ms", INTEGER },
+    { "travel-feed", INTEGER },
+    { "z-feed", INTEGER },
+    { "approach-feed", INTEGER },
+};
+}  // namespace
+
+GCodeTemplate::Values::Values() {
+    for (int i = 0; i < FIELD_COUNT; ++i) {
+        number[i] = 0;
+        text[i] = "";
+    }
+}
+
+bool GCodeTemplate::Compile(const std::string &text, uint32_t allowed,
+                            std::string *error, int *error_line) {
+    literals_.clear();
+    segments_.clear();
+    used_ = 0;
+    Segment literal = { -1, 0, 0 };
+    int line = 1;
+    bool in_comment = false;
+    auto fail = [&](const std::string &message) {
+        *error = message;
+        if (error_line) *error_line = line;
+        return false;
+    };
+    for (size_t pos = 0; pos < text.size(); ++pos) {
+        const char c = text[pos];
+        if (c == '\n') {
+            ++line;
+            in_comment = false;
+        } else if (c == ';') {
+            in_comment = true;
+        }
+        if ((c == '{' || c == '}') && pos + 1 < text.size()
+            && text[pos + 1] == c) {
+            literals_.push_back(c);   // Escaped brace.
+            ++literal.len;
+            ++pos;
+            continue;
+        }
+        if (c == '}')
+            return fail("'}' without '{'");
+        if (c != '{') {
+            literals_.push_back(c);
+            ++literal.len;
+            continue;
+        }
+        const size_t close = text.find('}', pos);
+        const size_t newline = text.find('\n', pos);
+        if (close == std::string::npos || close > newline)
+            return fail("'{' without '}'");
+        const std::string name = text.substr(pos + 1, close - pos - 1);
+        int field = 0;
+        while (field < FIELD_COUNT && name != kFields[field].name) ++field;
+        if (field == FIELD_COUNT)
+            return fail("unknown placeholder {" + name + "}");
+        if (!(allowed & (1 << field)))
+            return fail("{" + name + "} can't be used here");
+        if (!in_comment) used_ |= 1 << field;
+        if (literal.len > 0) segments_.push_back(literal);
+        const Segment placeholder = { field, 0, 0 };
+        segments_.push_back(placeholder);
+        literal.begin = literals_.size();
+        literal.len = 0;
+        pos = close;
+    }
+    if (literal.len > 0) segments_.push_back(literal);
+    return true;
+}
+
+void GCodeTemplate::Expand(const Values &values, OutputBuffer *out) const {
+    const char *const literals = literals_.data();
+    for (const Segment &s : segments_) {
+        if (s.field < 0) {
+            out->Append(literals + s.begin, s.len);
+            continue;
+        }
+        switch (kFields[s.field].type) {
+        case TEXT:
+            out->Append(values.text[s.field]);
+            break;
+        case COORDINATE:
+            out->AppendFixed(values.number[s.field], 3);
+            break;
+        case INTEGER:
+            out->AppendInt(values.number[s.field]);
+            break;
+        }
+    }
+}
+
+bool GCodeTemplates::Load(const char *filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        fprintf(stderr, "Can't read G-code templates from %s\n", filename);
+        return false;
+    }
+    GCodeTemplate *current = NULL;
+    uint32_t allowed = 0;
+    std::string text, line;
+    std::vector<int> text_lines;   // Line in the file of each line of text.
+    int line_no = 0;
+    bool pick_given = false, place_given = false;
+    bool pick_approach_given = false, place_approach_given = false;
+    auto compile = [&]() {
+        std::string error;
+        int error_line = 0;
+        if (current && !current->Compile(text, allowed, &error,
+                                         &error_line)) {
+            fprintf(stderr, "%s:%d: %s\n", filename,
+                    text_lines[error_line - 1], error.c_str());
+            return false;
+        }
+        return true;
+    };
+    while (std::getline(in, line)) {
+        ++line_no;
+        if (!line.empty() && line[0] == '#')
+            continue;   // Comment about the template.
+        if (line.empty() || line[0] != '[') {
+            if (current == NULL && !line.empty()) {
+                fprintf(stderr, "%s:%d: G-code before the first [section]\n",
+                        filename, line_no);
+                return false;
+            }
+            text.append(line).append("\n");
+            text_lines.push_back(line_no);
+            continue;
+        }
+        if (!compile())
+            return false;
+        allowed = GCodeTemplate::kAllFields;
+        if (line == "[preamble]" || line == "[finish]") {
+            current = line == "[preamble]" ? &preamble : &finish;
+            allowed &= ~GCodeTemplate::kMoveFields;
+        } else if (line == "[pick]") {
+            current = &pick;
+            pick_given = true;
+        } else if (line == "[place]") {
+            current = &place;
+            place_given = true;
+        } else if (line == "[pick-approach]") {
+            current = &pick_approach;
+            pick_approach_given = true;
+        } else if (line == "[place-approach]") {
+            current = &place_approach;
+            place_approach_given = true;
+        } else if (line == "[select-nozzle]") {
+            current = &select_nozzle;
+        } else {
+            fprintf(stderr, "%s:%d: unknown section %s\n", filename, line_no,
+                    line.c_str());
+            return false;
+        }
+        text.clear();
+        text_lines.clear();
+    }
+    if (!compile())
+        return false;
+    // The built-in approach sections would not go with the file's others.
+    if (pick_given && !pick_approach_given) pick_approach = pick;
+    if (place_given && !place_approach_given) place_approach = place;
+    return true;
+}
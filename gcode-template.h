@@ -0,0 +1,99 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * G-code templates with named placeholders such as {x} or {name}, compiled
+ * once so that filling them in for each part is just copying.
+ */
+#ifndef PNP_GCODE_TEMPLATE_H
+#define PNP_GCODE_TEMPLATE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "output-buffer.h"
+
+class GCodeTemplate {
+public:
+    // What can be filled in. Coordinates and angles are written with three
+    // decimals, numbers as integers.
+    enum Field {
+        // Per move: only in the pick, place and select-nozzle templates.
+        NAME,           // {name}   Component name, e.g. R42
+        KEY,            // {key}    <footprint>@<value>
+        X, Y,           // {x} {y}  Where the first nozzle goes.
+        Z_UP,           // {zup}    Travel height.
+        Z_DOWN,         // {zdown}  Picking or placing height.
+        Z_NEAR,         // {znear}  Slow approach from here down.
+        Z_RETRACT,      // {zretract}       Back up to travel height.
+        Z_RETRACT_NEAR, // {zretract-near}  Slowly up to here.
+        Z_LIFT,         // {zlift}  Straight up at least to here before
+                        //          traveling on; see GCodePeephole.
+        ANGLE,          // {angle}  Nozzle rotation in degrees.
+        E,              // {e}      Nozzle rotation on the E-axis.
+        TOOL,           // {tool}   Nozzle, first is 1.
+        VACUUM_PIN,     // {vacuum-pin}
+        BLOW_PIN,       // {blow-pin}
+        // Machine: anywhere.
+        BLOW_MS,        // {blow-ms}
+        TRAVEL_FEED,    // {travel-feed}    xy-speed: in mm/min
+        Z_FEED,         // {z-feed}         z-speed: in mm/min
+        APPROACH_FEED,  // {approach-feed}  approach-speed: (or z-speed:)
+        FIELD_COUNT
+    };
+    static const uint32_t kMoveFields = (1 << BLOW_MS) - 1;
+    static const uint32_t kAllFields = (1 << FIELD_COUNT) - 1;
+
+    GCodeTemplate() : used_(0) {}
+
+    // Values to fill in, by field. Text fields use "text", all others
+    // "number".
+    struct Values {
+        Values();
+        float number[FIELD_COUNT];
+        const char *text[FIELD_COUNT];
+    };
+
+    // Compile "text", which may use the fields in the "allowed" bits.
+    // "{{" and "}}" are a literal brace. Returns false with a message in
+    // "error" if a placeholder is unknown, not allowed or not closed; then
+    // "error_line", if given, is the line of "text" it is on, first is 1.
+    bool Compile(const std::string &text, uint32_t allowed,
+                 std::string *error, int *error_line = NULL);
+
+    // Whether "field" is filled in outside of a ';' comment.
+    bool Uses(Field field) const { return (used_ & (1 << field)) != 0; }
+
+    void Expand(const Values &values, OutputBuffer *out) const;
+
+private:
+    struct Segment {
+        int field;             // -1 for a literal.
+        size_t begin, len;     // Literal in literals_.
+    };
+    std::string literals_;
+    std::vector<Segment> segments_;
+    uint32_t used_;
+};
+
+// All that makes up the pick'n place G-code.
+struct GCodeTemplates {
+    GCodeTemplate preamble;        // Fills in machine fields.
+    GCodeTemplate pick;
+    GCodeTemplate place;
+    GCodeTemplate pick_approach;   // Used instead of pick and place with
+    GCodeTemplate place_approach;  // an approach-speed: in the config.
+    GCodeTemplate select_nozzle;   // Only with more than one nozzle.
+    GCodeTemplate finish;          // Machine fields.
+
+    // Replace the templates given in "filename". Each starts with a line
+    // [preamble], [pick], [place], [pick-approach], [place-approach],
+    // [select-nozzle] or [finish] and goes until the next. Lines starting
+    // with '#' are comments. A [pick] or [place] without its -approach
+    // section is used for both. Returns false, with a message and line
+    // number on stderr, if the file can't be read or has errors.
+    bool Load(const char *filename);
+};
+
+#endif  // PNP_GCODE_TEMPLATE_H
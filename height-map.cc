@@ -0,0 +1,112 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "height-map.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+HeightMap::HeightMap(float cell_size) : cell_size_(cell_size) {}
+
+int HeightMap::Cell(float v) const {
+    return (int) floorf(v / cell_size_);
+}
+
+// Larger boxes are not worth filling into cells.
+static const int kMaxCells = 256;
+
+void HeightMap::Add(const Box &box, float top) {
+    const long cells = (long)(Cell(box.p1.x) - Cell(box.p0.x) + 1)
+        * (Cell(box.p1.y) - Cell(box.p0.y) + 1);
+    if (cells > kMaxCells) {
+        large_.push_back(std::make_pair(box, top));
+        return;
+    }
+    if (top_.empty()) {
+        bounds_ = box;
+    } else {
+        bounds_.p0.x = std::min(bounds_.p0.x, box.p0.x);
+        bounds_.p0.y = std::min(bounds_.p0.y, box.p0.y);
+        bounds_.p1.x = std::max(bounds_.p1.x, box.p1.x);
+        bounds_.p1.y = std::max(bounds_.p1.y, box.p1.y);
+    }
+    for (int x = Cell(box.p0.x); x <= Cell(box.p1.x); ++x) {
+        for (int y = Cell(box.p0.y); y <= Cell(box.p1.y); ++y) {
+            auto inserted = top_.insert(std::make_pair(Key(x, y), top));
+            if (!inserted.second && inserted.first->second < top)
+                inserted.first->second = top;
+        }
+    }
+}
+
+float HeightMap::MaxAlong(const Position &from, const Position &to,
+                          float margin, float floor) const {
+    float result = floor;
+    float t0, t1;
+    for (const auto &large : large_) {
+        if (large.second > result
+            && Clip(from, to, margin, large.first, &t0, &t1))
+            result = large.second;
+    }
+    // Only the part of the line that gets close to the cells matters.
+    const float step = cell_size_;
+    const float reach = margin + step / 2;
+    if (top_.empty() || !Clip(from, to, reach, bounds_, &t0, &t1))
+        return result;
+    const Position begin(from.x + t0 * (to.x - from.x),
+                         from.y + t0 * (to.y - from.y));
+    const Position end(from.x + t1 * (to.x - from.x),
+                       from.y + t1 * (to.y - from.y));
+    // Samples a cell apart; every point of the line is within half a cell
+    // of one, which is added to the margin around each.
+    const int samples = (int) ceilf(Distance(begin, end) / step) + 1;
+    int last_x0 = 0, last_y0 = 0, last_x1 = -1, last_y1 = -1;
+    for (int i = 0; i < samples; ++i) {
+        const float f = samples > 1 ? (float) i / (samples - 1) : 0;
+        const float x = begin.x + f * (end.x - begin.x);
+        const float y = begin.y + f * (end.y - begin.y);
+        const int x0 = Cell(x - reach), x1 = Cell(x + reach);
+        const int y0 = Cell(y - reach), y1 = Cell(y + reach);
+        if (x0 == last_x0 && x1 == last_x1 && y0 == last_y0 && y1 == last_y1)
+            continue;   // Same cells as before.
+        for (int cx = x0; cx <= x1; ++cx) {
+            for (int cy = y0; cy <= y1; ++cy) {
+                auto found = top_.find(Key(cx, cy));
+                if (found != top_.end())
+                    result = std::max(result, found->second);
+            }
+        }
+        last_x0 = x0; last_x1 = x1; last_y0 = y0; last_y1 = y1;
+    }
+    return result;
+}
+
+bool HeightMap::Clip(const Position &from, const Position &to,
+                     float margin, const Box &box, float *t0_out,
+                     float *t1_out) {
+    // Clip the line to the slabs of the grown box in x and y.
+    const float lo[2] = { box.p0.x - margin, box.p0.y - margin };
+    const float hi[2] = { box.p1.x + margin, box.p1.y + margin };
+    const float start[2] = { from.x, from.y };
+    const float delta[2] = { to.x - from.x, to.y - from.y };
+    float t0 = 0, t1 = 1;
+    for (int a = 0; a < 2; ++a) {
+        if (delta[a] == 0) {
+            if (start[a] < lo[a] || start[a] > hi[a])
+                return false;
+            continue;
+        }
+        float enter = (lo[a] - start[a]) / delta[a];
+        float leave = (hi[a] - start[a]) / delta[a];
+        if (enter > leave) std::swap(enter, leave);
+        t0 = std::max(t0, enter);
+        t1 = std::min(t1, leave);
+        if (t0 > t1)
+            return false;
+    }
+    *t0_out = t0;
+    *t1_out = t1;
+    return true;
+}
@@ -0,0 +1,53 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * How high things stick out on the bed, to travel just above them.
+ */
+#ifndef PNP_HEIGHT_MAP_H
+#define PNP_HEIGHT_MAP_H
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rpt2pnp.h"
+
+// The highest point per square cell of a grid; only cells that have
+// something in them are stored. Answers are conservative: anything in a
+// cell counts as covering the whole cell. Boxes too large for that, such
+// as long tapes, are kept as they are and checked one by one.
+class HeightMap {
+public:
+    explicit HeightMap(float cell_size = 2.0);
+
+    void Clear() { top_.clear(); large_.clear(); }
+
+    // Everything within "box" is up to "top" high.
+    void Add(const Box &box, float top);
+
+    // Highest point within "margin" of the straight line from "from" to
+    // "to"; "floor" if nothing there is higher.
+    float MaxAlong(const Position &from, const Position &to,
+                   float margin, float floor) const;
+
+private:
+    int Cell(float v) const;
+    static int64_t Key(int x, int y) {
+        return (int64_t)((uint64_t)(uint32_t)x << 32 | (uint32_t)y);
+    }
+
+    // Part of the line from "from" (0) to "to" (1) that comes within
+    // "margin" of "box", as fractions in "t0" and "t1". Returns false if
+    // it doesn't get close.
+    static bool Clip(const Position &from, const Position &to,
+                     float margin, const Box &box, float *t0, float *t1);
+
+    const float cell_size_;
+    std::unordered_map<int64_t, float> top_;
+    Box bounds_;   // Of everything in top_.
+    std::vector<std::pair<Box, float> > large_;
+};
+
+#endif  // PNP_HEIGHT_MAP_H
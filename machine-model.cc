@@ -0,0 +1,50 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "machine-model.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+MachineModel::MachineModel()
+    : xy_speed(40), xy_accel(1000), z_speed(10), z_accel(200),
+      rotation_speed(90), rotation_accel(360), hover(10),
+      hover_margin(0), approach_speed(0), approach_height(1), board_z(-2.0),
+      blow_ms(100), e_per_degree(50.34965 / 360), min_z(0),
+      clearance(2), nozzles(1) {
+}
+
+float MachineModel::AxisTime(float distance, float speed, float accel) {
+    distance = fabsf(distance);
+    if (distance == 0)
+        return 0;
+    // Distance it takes to get to full speed and back to zero.
+    const float ramps = speed * speed / accel;
+    if (distance >= ramps)
+        return distance / speed + speed / accel;
+    return 2 * sqrtf(distance / accel);   // Never reaching full speed.
+}
+
+float MachineModel::MoveTime(const Position &from, const Position &to,
+                             float rotation) const {
+    return std::max(AxisTime(Distance(from, to), xy_speed, xy_accel),
+                    AxisTime(rotation, rotation_speed, rotation_accel));
+}
+
+float MachineModel::ZTime(float distance) const {
+    if (approach_speed <= 0)
+        return AxisTime(distance, z_speed, z_accel);
+    const float slow = std::min(distance, approach_height);
+    return AxisTime(distance - slow, z_speed, z_accel)
+        + AxisTime(slow, approach_speed, z_accel);
+}
+
+float MachineModel::PickTime() const {
+    return 2 * ZTime(hover);
+}
+
+float MachineModel::PlaceTime() const {
+    return 2 * ZTime(hover - board_z) + blow_ms / 1000;
+}
@@ -0,0 +1,65 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * What the pick'n place machine looks like and how fast it moves.
+ */
+#ifndef PNP_MACHINE_MODEL_H
+#define PNP_MACHINE_MODEL_H
+
+#include <vector>
+
+#include "rpt2pnp.h"
+
+// A nozzle on the head; each has its own rotation axis (selected with
+// T<n>, first nozzle is T1) and vacuum.
+struct Nozzle {
+    Nozzle() : vacuum_pin(6), blow_pin(8) {}
+    Position offset;   // from the position of the first nozzle.
+    int vacuum_pin;
+    int blow_pin;
+};
+
+// Axis limits and fixed times, to estimate how long things take. Moves
+// start and end at rest and follow a trapezoid speed profile: accelerate,
+// go at full speed, slow down.
+struct MachineModel {
+    MachineModel();
+
+    float xy_speed;         // mm/s
+    float xy_accel;         // mm/s^2
+    float z_speed;          // mm/s
+    float z_accel;          // mm/s^2
+    float rotation_speed;   // degrees/s of the nozzle.
+    float rotation_accel;   // degrees/s^2
+    float hover;            // Travel height above pick height in mm.
+    float hover_margin;     // Above what is in the way; 0: always hover.
+    float approach_speed;   // mm/s close to contact; 0: all at z_speed.
+    float approach_height;  // mm above contact to go at approach_speed.
+    float board_z;          // Place height relative to pick height.
+    float blow_ms;          // Blowing the component off the nozzle.
+    float e_per_degree;     // E-axis units for one degree of rotation.
+    float min_z;            // Nozzle must never go lower than this.
+    float clearance;        // Lift before the nozzle may move sideways.
+    Dimension bed;          // Reachable x/y area; 0 if unknown.
+
+    // Parts are picked and placed in batches of one per nozzle.
+    std::vector<Nozzle> nozzles;
+
+    // Time for "distance" on an axis, starting and stopping at rest.
+    static float AxisTime(float distance, float speed, float accel);
+
+    // Travel at hover height, rotating the nozzle by "rotation" degrees on
+    // the way. Axes move at the same time, so the slowest counts.
+    float MoveTime(const Position &from, const Position &to,
+                   float rotation) const;
+
+    // Going up or down by "distance" to or from contact, the part close to
+    // it at approach speed.
+    float ZTime(float distance) const;
+
+    // Going down, picking up or placing, and going back up.
+    float PickTime() const;
+    float PlaceTime() const;
+};
+
+#endif  // PNP_MACHINE_MODEL_H
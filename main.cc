@@ -3,18 +3,24 @@
  */
 
 #include <assert.h>
+#include <getopt.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
 #include <string>
 #include <vector>
 #include <map>
 
+#include "alloc-stats.h"
 #include "board.h"
+#include "gcode-peephole.h"
+#include "multi-printer.h"
 #include "pnp-config.h"
+#include "pnp-planner.h"
 #include "postscript-printer.h"
 #include "printer.h"
 #include "rpt-parser.h"
@@ -34,8 +40,40 @@ static int usage(const char *prog) {
             "[Operations]\n"
             "\t-c <config> : Use edited config from -t \n"
             "\t-C <config> : Use homer config created via homer from -h\n"
-            "\t-p      : Pick'n place. Requires a config and rpt.\n"
+            "\t-p      : Pick'n place. Requires a config and rpt. Parts are\n"
+            "\t          ordered for short travel between tapes and board.\n"
             "\t-P      : Output as PostScript.\n"
+            "\t--gcode-template <file> : Pick'n place G-code templates\n"
+            "\t          for the machine's dialect; see templates/.\n"
+            "\t--estimate : Instead of pick'n place G-code, print how long\n"
+            "\t          the job is estimated to take.\n"
+            "\t--output <kind>=<file> : Also write <kind> to <file> ('-' is\n"
+            "\t          stdout), from the same board and route: gcode\n"
+            "\t          (pick'n place), ps (PostScript) or report (parts in\n"
+            "\t          placing order). Can be given more than once.\n"
+            "\t--threaded-output <kind>=<file> : Like --output, formatted\n"
+            "\t          on a thread of its own.\n"
+            "[Tuning]\n"
+            "\t-j <threads> : Parse rpt with this many threads.\n"
+            "\t-b      : Write or refresh compiled board cache <rpt-file>c\n"
+            "\t-s      : Print board loading and output statistics to stderr.\n"
+            "\t--output-threads <n> : Format pick'n place G-code with this\n"
+            "\t          many threads.\n"
+            "\t--gcode-rewrite <list> : Optimize the G-code output with a\n"
+            "\t          comma separated list of rewrites: lift (straight\n"
+            "\t          up only by the clearance before traveling), noop\n"
+            "\t          (drop what doesn't change anything), feed (drop\n"
+            "\t          repeated feedrates), dwell (drop and merge G4).\n"
+            "\t          Or 'all'. Reports savings to stderr.\n"
+            "\t--optimize-ms <ms> : Optimize the route through the parts for\n"
+            "\t          up to this many milliseconds. Default: file order.\n"
+            "\t--optimize-threads <n> : Threads used to optimize the route.\n"
+            "\t--optimize-seed <n> : Random seed for route optimization.\n"
+            "\t--optimize-rounds <n> : Stop route optimization after this\n"
+            "\t          many rounds. Same seed, threads and rounds give the\n"
+            "\t          same route.\n"
+            "\t--low-parts-first : Place parts by their part-height:,\n"
+            "\t          lowest first, so the nozzle travels low longer.\n"
 #if 0
             // dry run gcode.
             // not working right now.
@@ -51,31 +89,62 @@ static int usage(const char *prog) {
 typedef std::map<std::string, int> ComponentCount;
 
 // Extract components on board and their counts. Returns total components found.
-int ExtractComponents(const Board::PartList& list, ComponentCount *c) {
-    int total_count = 0;
-    for (const Part* part : list) {
-        const std::string key = part->footprint + "@" + part->value;
-        (*c)[key]++;
-        ++total_count;
-    }
-    return total_count;
-}
-
-const Part *FindPartClosestTo(const Board::PartList& list, const Position &pos) {
-    const Part* result = NULL;
-    float closest = -1;
-    for (const Part* part : list) {
-        const float dist = Distance(part->pos, pos);
-        if (closest < 0 || dist < closest) {
-            result = part;
-            closest = dist;
-        }
+int ExtractComponents(const PartTable& list, ComponentCount *c) {
+    // Count per component key ID, then sort by name only the distinct keys.
+    const StringTable &keys = list.component_keys();
+    std::vector<int> key_count(keys.size());
+    for (int i = 0; i < list.size(); ++i) {
+        key_count[list.component_key_id(i)]++;
+    }
+    for (int id = 0; id < keys.size(); ++id) {
+        if (key_count[id] > 0)
+            (*c)[keys.str(id)] += key_count[id];
     }
-    return result;
+    return list.size();
 }
 
-void CreateConfigTemplate(const Board::PartList& list) {
-    printf("Board:\norigin: 100 100 # x/y origin of the board\n\n");    
+void CreateConfigTemplate(const PartTable& list) {
+    ComponentCount components;
+    const int total_count = ExtractComponents(list, &components);
+
+    printf("Board:\norigin: 100 100 # x/y origin of the board\n");
+    printf("# Optional: height of the parts in mm by footprint, for\n");
+    printf("# hover-margin: below and --low-parts-first.\n");
+    std::string last_footprint;
+    for (const auto &pair : components) {
+        const std::string &key = pair.first;
+        const std::string footprint = key.substr(0, key.find('@'));
+        if (footprint == last_footprint) continue;   // Keys are sorted.
+        printf("#part-height: %s 1\n", footprint.c_str());
+        last_footprint = footprint;
+    }
+    printf("\n");
+    printf("Machine:  # Speeds, used to find a quick order of parts.\n");
+    printf("xy-speed: 40        # mm/s\n");
+    printf("rotation-speed: 90  # degrees/s nozzle rotation\n");
+    printf("# Optional, to estimate times:\n");
+    printf("#xy-accel: 1000      # mm/s^2\n");
+    printf("#z-speed: 10         # mm/s\n");
+    printf("#z-accel: 200        # mm/s^2\n");
+    printf("#rotation-accel: 360 # degrees/s^2\n");
+    printf("#hover: 10           # mm above pick height while moving\n");
+    printf("#blow-ms: 100        # blowing component off after placing\n");
+    printf("# Travel with G0 at full speed, but go slowly close to the\n");
+    printf("# component; without approach-speed, all moves are G1 F2500:\n");
+    printf("#approach-speed: 5   # mm/s\n");
+    printf("#approach-height: 1  # mm above contact\n");
+    printf("# Travel only this much above what is in the way instead of\n");
+    printf("# always at hover; needs part-height: of the parts:\n");
+    printf("#hover-margin: 1     # mm\n");
+    printf("# For checking G-code with gcode-sim:\n");
+    printf("#min-z: 0            # lowest the nozzle may go\n");
+    printf("#bed: 300 200        # x/y travel of the head\n");
+    printf("# Straight up this much before moving sideways, with\n");
+    printf("# --gcode-rewrite lift:\n");
+    printf("#clearance: 2        # mm\n");
+    printf("# For a head with several nozzles, one line each with its x/y\n");
+    printf("# offset from the first, and optionally vacuum and blow pin:\n");
+    printf("#nozzle: 0 0 6 8\n#nozzle: 20 0 7 9\n\n");
 
     printf("# This template provides one <footprint>@<component> per tape,\n");
     printf("# but if you have multiple components that are indeed the same\n");
@@ -89,10 +158,14 @@ void CreateConfigTemplate(const Board::PartList& list) {
     printf("# Also there are the following optional parameters\n");
     printf("#angle: 0     # Optional: Default rotation of component on tape.\n");
     printf("#count: 1000  # Optional: available count on tape\n");
+    printf("#\n# If a component is on several tapes, list it behind each of\n");
+    printf("# their Tape: lines; each part is taken from the tape that is\n");
+    printf("# closest to where it goes, as long as there are components.\n");
+    printf("#\n# Components in a tray instead of a tape get a Tray: section;\n");
+    printf("# 'spacing:' is the distance between columns and rows, and\n");
+    printf("# 'grid: <columns> <rows>' its size. Taken row by row.\n");
     printf("\n");
 
-    ComponentCount components;
-    const int total_count = ExtractComponents(list, &components);
     for (const auto &pair : components) {
         printf("\nTape: %s\n", pair.first.c_str());
         printf("origin:  10 20 2 # fill me\n");
@@ -101,7 +174,7 @@ void CreateConfigTemplate(const Board::PartList& list) {
     fprintf(stderr, "%d components total\n", total_count);
 }
 
-void CreateList(const Board::PartList& list) {
+void CreateList(const PartTable& list) {
     ComponentCount components;
     const int total_count = ExtractComponents(list, &components);
     int longest = -1;
@@ -126,16 +199,18 @@ void CreateHomerInstruction(const Board &board) {
                    next_pos, pair.first.c_str(), next_pos);
         }
     }
-    const Part *board_part = FindPartClosestTo(board.parts(), Position(0, 0));
-    if (board_part) {
+    const PartTable &parts = board.parts();
+    const SpatialIndex &index = board.spatial_index();
+    int board_part = index.FindNearest(Position(0, 0));
+    if (board_part >= 0) {
         printf("board:%s\tfind component center on board (bottom left)\n",
-               board_part->component_name.c_str());
+               parts.part(board_part).component_name);
     }
-    board_part = FindPartClosestTo(board.parts(), Position(board.dimension().w,
-                                                           board.dimension().h));
-    if (board_part) {
+    board_part = index.FindNearest(Position(board.dimension().w,
+                                            board.dimension().h));
+    if (board_part >= 0) {
         printf("board:%s\tfind component center on board (top right)\n",
-               board_part->component_name.c_str());
+               parts.part(board_part).component_name);
     }
 }
 
@@ -149,15 +224,64 @@ int main(int argc, char *argv[]) {
         OUT_CONFIG_LIST,
         OUT_HOMER_INSTRUCTION,
         OUT_PICKNPLACE,
+        OUT_REPORT,
     } output_type = OUT_NONE;
 
+    // Printers in addition to the one chosen by output_type, from --output.
+    struct ExtraOutput {
+        OutputType type;
+        const char *spec;      // <kind>=<file>
+        const char *filename;
+        bool own_thread;
+    };
+    std::vector<ExtraOutput> extra_outputs;
+
     float start_ms = minimum_milliseconds;
     float area_ms = area_to_milliseconds;
     const char *config_filename = NULL;
     const char *simple_config_filename = NULL;
+    int parse_threads = 1;
+    bool write_board_cache = false;
+    bool print_stats = false;
+    int optimize_ms = -1;
+    RouteOptions route_options;
+    bool estimate_only = false;
+    int output_threads = 1;
+    int gcode_rewrites = 0;
+    bool low_parts_first = false;
+    const char *gcode_template = NULL;
+
+    enum LongOptionsOnly {
+        OPT_OPTIMIZE_MS = 1000,
+        OPT_OPTIMIZE_THREADS,
+        OPT_OPTIMIZE_SEED,
+        OPT_OPTIMIZE_ROUNDS,
+        OPT_ESTIMATE,
+        OPT_OUTPUT_THREADS,
+        OPT_GCODE_REWRITE,
+        OPT_LOW_PARTS_FIRST,
+        OPT_GCODE_TEMPLATE,
+        OPT_OUTPUT,
+        OPT_THREADED_OUTPUT,
+    };
+    static const struct option long_options[] = {
+        { "optimize-ms", required_argument, NULL, OPT_OPTIMIZE_MS },
+        { "optimize-threads", required_argument, NULL, OPT_OPTIMIZE_THREADS },
+        { "optimize-seed", required_argument, NULL, OPT_OPTIMIZE_SEED },
+        { "optimize-rounds", required_argument, NULL, OPT_OPTIMIZE_ROUNDS },
+        { "estimate", no_argument, NULL, OPT_ESTIMATE },
+        { "output-threads", required_argument, NULL, OPT_OUTPUT_THREADS },
+        { "gcode-rewrite", required_argument, NULL, OPT_GCODE_REWRITE },
+        { "low-parts-first", no_argument, NULL, OPT_LOW_PARTS_FIRST },
+        { "gcode-template", required_argument, NULL, OPT_GCODE_TEMPLATE },
+        { "output", required_argument, NULL, OPT_OUTPUT },
+        { "threaded-output", required_argument, NULL, OPT_THREADED_OUTPUT },
+        { NULL, 0, NULL, 0 },
+    };
 
     int opt;
-    while ((opt = getopt(argc, argv, "Pc:C:tlhpd:D:")) != -1) {
+    while ((opt = getopt_long(argc, argv, "Pc:C:tlhpd:D:j:bs",
+                              long_options, NULL)) != -1) {
         switch (opt) {
         case 'P':
             output_type = OUT_POSTSCRIPT;
@@ -188,6 +312,66 @@ int main(int argc, char *argv[]) {
             output_type = OUT_DISPENSING;
             area_ms = atof(optarg);
             break;
+        case 'j':
+            parse_threads = atoi(optarg);
+            break;
+        case 'b':
+            write_board_cache = true;
+            break;
+        case 's':
+            print_stats = true;
+            break;
+        case OPT_OPTIMIZE_MS:
+            optimize_ms = atoi(optarg);
+            break;
+        case OPT_OPTIMIZE_THREADS:
+            route_options.threads = atoi(optarg);
+            break;
+        case OPT_OPTIMIZE_SEED:
+            route_options.seed = strtoul(optarg, NULL, 10);
+            break;
+        case OPT_OPTIMIZE_ROUNDS:
+            route_options.max_rounds = atoi(optarg);
+            break;
+        case OPT_ESTIMATE:
+            estimate_only = true;
+            output_type = OUT_PICKNPLACE;
+            break;
+        case OPT_OUTPUT_THREADS:
+            output_threads = atoi(optarg);
+            break;
+        case OPT_GCODE_REWRITE:
+            gcode_rewrites = GCodePeephole::ParseRewrites(optarg);
+            if (gcode_rewrites < 0) {
+                fprintf(stderr, "Unknown G-code rewrite in '%s'\n", optarg);
+                return usage(argv[0]);
+            }
+            break;
+        case OPT_LOW_PARTS_FIRST:
+            low_parts_first = true;
+            break;
+        case OPT_GCODE_TEMPLATE:
+            gcode_template = optarg;
+            break;
+        case OPT_OUTPUT:
+        case OPT_THREADED_OUTPUT: {
+            ExtraOutput extra;
+            extra.spec = optarg;
+            extra.own_thread = (opt == OPT_THREADED_OUTPUT);
+            const char *equals = strchr(optarg, '=');
+            const std::string kind(optarg, equals ? equals - optarg : 0);
+            if (kind == "gcode") extra.type = OUT_PICKNPLACE;
+            else if (kind == "ps") extra.type = OUT_POSTSCRIPT;
+            else if (kind == "report") extra.type = OUT_REPORT;
+            else {
+                fprintf(stderr, "Output needs to be gcode=<file>, "
+                        "ps=<file> or report=<file>; got '%s'\n", optarg);
+                return usage(argv[0]);
+            }
+            extra.filename = equals + 1;
+            extra_outputs.push_back(extra);
+            break;
+        }
         default: /* '?' */
             return usage(argv[0]);
         }
@@ -196,14 +380,28 @@ int main(int argc, char *argv[]) {
     if (optind >= argc) {
         return usage(argv[0]);
     }
+    if (estimate_only && !extra_outputs.empty()) {
+        // Would leave them empty.
+        fprintf(stderr, "--estimate doesn't write --output files.\n");
+        return 1;
+    }
 
     const char *rpt_file = argv[optind];
 
+    const size_t allocs_before = HeapAllocationCount();
+    const size_t bytes_before = HeapAllocationBytes();
     Board board;
-    if (!board.ReadPartsFromRpt(rpt_file))
+    if (!board.ReadPartsFromRpt(rpt_file, parse_threads,
+                                write_board_cache))
         return 1;
+    if (print_stats) {
+        board.DebugPrintStats();
+        fprintf(stderr, "Board loading: %zu heap allocations, %zu kiB\n",
+                HeapAllocationCount() - allocs_before,
+                (HeapAllocationBytes() - bytes_before) >> 10);
+    }
 
-    if (output_type == OUT_NONE
+    if (output_type == OUT_NONE && extra_outputs.empty()
         && (config_filename != NULL || simple_config_filename != NULL)) {
         output_type = OUT_PICKNPLACE;
     }
@@ -228,39 +426,203 @@ int main(int argc, char *argv[]) {
     } else if (simple_config_filename != NULL) {
         config = ParseSimplePnPConfiguration(board, simple_config_filename);
     }
+    if (config != NULL) {
+        ResolveComponentKeys(board.parts(), config);
+    }
 
-    Printer *printer = NULL;
-    switch (output_type) {
-    case OUT_DISPENSING:
-        printer = new GCodeDispensePrinter(start_ms, area_ms);
-        break;
-    case OUT_CORNER_GCODE:
-        printer = new GCodeCornerIndicator(start_ms, area_ms);
-        break;
-    case OUT_POSTSCRIPT:
-        printer = new PostScriptPrinter(config);
-        break;
-    case OUT_PICKNPLACE:
-        printer = new GCodePickNPlace(config);
-        break;
-    default:
-        break;
-    }
-
-    if (printer == NULL) {
+    if (output_type == OUT_NONE && extra_outputs.empty()) {
         usage(argv[0]);
         return 1;
     }
 
-    printer->Init(board.dimension());
+    // Picking advances the tapes in the config, so only one output can
+    // do that. Outputs on stdout would be mixed up.
+    int picknplace_outputs = (output_type == OUT_PICKNPLACE);
+    int stdout_outputs = (output_type != OUT_NONE);
+    for (const ExtraOutput &extra : extra_outputs) {
+        picknplace_outputs += (extra.type == OUT_PICKNPLACE);
+        stdout_outputs += (strcmp(extra.filename, "-") == 0);
+    }
+    if (picknplace_outputs > 0 && config == NULL) {
+        fprintf(stderr, "Pick'n place needs a configuration (-c or -C).\n");
+        return 1;
+    }
+    if (picknplace_outputs > 1) {
+        fprintf(stderr, "Only one pick'n place output at a time.\n");
+        return 1;
+    }
+    if (stdout_outputs > 1) {
+        fprintf(stderr, "Only one output can go to stdout.\n");
+        return 1;
+    }
+
+    // Printer for "type" writing to "out". NULL if it can't be created.
+    auto create_printer = [&](OutputType type, FILE *out) -> Printer* {
+        switch (type) {
+        case OUT_DISPENSING:
+            return new GCodeDispensePrinter(start_ms, area_ms);
+        case OUT_CORNER_GCODE:
+            return new GCodeCornerIndicator(start_ms, area_ms);
+        case OUT_POSTSCRIPT:
+            return new PostScriptPrinter(config, out);
+        case OUT_REPORT:
+            return new ReportPrinter(config, out);
+        case OUT_PICKNPLACE: {
+            GCodePickNPlace *pnp
+                = new GCodePickNPlace(config, output_threads, out);
+            if (gcode_template && !pnp->LoadTemplates(gcode_template)) {
+                delete pnp;
+                return NULL;
+            }
+            return pnp;
+        }
+        default:
+            return NULL;
+        }
+    };
+
+    // All printers, each with the file it writes to.
+    struct Output {
+        OutputType type;
+        const char *spec;   // NULL for the one on stdout chosen by options.
+        FILE *file;
+        Printer *printer;
+        bool own_thread;
+    };
+    std::vector<Output> outputs;
+    if (output_type != OUT_NONE) {
+        Output output = { output_type, NULL, stdout, NULL, false };
+        outputs.push_back(output);
+    }
+    for (const ExtraOutput &extra : extra_outputs) {
+        Output output = { extra.type, extra.spec, stdout, NULL,
+                          extra.own_thread };
+        if (strcmp(extra.filename, "-") != 0) {
+            output.file = fopen(extra.filename, "w");
+            if (output.file == NULL) {
+                perror(extra.filename);
+                return 1;
+            }
+        }
+        outputs.push_back(output);
+    }
+    for (Output &output : outputs) {
+        output.printer = create_printer(output.type, output.file);
+        if (output.printer == NULL)
+            return 1;
+    }
+
+    std::vector<int> route(board.parts().size());
+    for (size_t i = 0; i < route.size(); ++i) route[i] = i;
+    if (optimize_ms >= 0) {
+        const float file_order = RouteLength(board.parts(), route);
+        OptimizeParts(board.parts(), &route);
+        const float nearest = RouteLength(board.parts(), route);
+        route_options.budget_ms = optimize_ms;
+        const int rounds = ImproveRoute(board.parts(), route_options, &route);
+        fprintf(stderr, "Route length: %.1fmm in file order; "
+                "%.1fmm nearest neighbor; %.1fmm after local search "
+                "(%d rounds).\n",
+                file_order, nearest, RouteLength(board.parts(), route),
+                rounds);
+    }
+
+    if (picknplace_outputs > 0) {
+        // What counts here is the way to the tapes and back to the board,
+        // and turning the nozzle.
+        const PickNPlaceCost given
+            = EstimatePickNPlace(board.parts(), *config, route, false);
+        if (!PlanPickNPlace(board.parts(), config, &route, low_parts_first))
+            return 1;
+        const PickNPlaceCost planned
+            = EstimatePickNPlace(board.parts(), *config, route, true);
+        fprintf(stderr, "Pick'n place travel: %.1fmm in given order; "
+                "%.1fmm planned (%.1fmm saved).\n",
+                given.travel, planned.travel, given.travel - planned.travel);
+        fprintf(stderr, "Nozzle rotation: %.0f degrees in given order; "
+                "%.0f planned (%.0f saved).\n", given.rotation,
+                planned.rotation, given.rotation - planned.rotation);
+        fprintf(stderr, "Estimated move time: %.1fs in given order; "
+                "%.1fs planned.\n", given.seconds, planned.seconds);
+        const int nozzles = config->machine.nozzles.size();
+        const float cycle_time = EstimateCycleTime(board.parts(), *config,
+                                                   route, nozzles);
+        if (nozzles > 1) {
+            fprintf(stderr, "Cycle time: %.1fs with one nozzle; "
+                    "%.1fs with %d nozzles.\n",
+                    EstimateCycleTime(board.parts(), *config, route, 1),
+                    cycle_time, nozzles);
+        }
+        if (estimate_only) {
+            const int seconds = roundf(cycle_time);
+            printf("Estimated job duration: %d:%02d:%02d (%.1fs)\n",
+                   seconds / 3600, seconds / 60 % 60, seconds % 60,
+                   cycle_time);
+            return 0;
+        }
+    }
+
+    // Rewrites go to the first G-code output.
+    GCodePeephole *peephole = NULL;
+    size_t rewritten_output = outputs.size();
+    if (gcode_rewrites) {
+        auto gcode = std::find_if(outputs.begin(), outputs.end(),
+                                  [](const Output &output) {
+                                      return output.type != OUT_POSTSCRIPT
+                                          && output.type != OUT_REPORT; });
+        if (gcode == outputs.end()) {
+            fprintf(stderr, "G-code rewrites need G-code output.\n");
+            return 1;
+        }
+        static const MachineModel kDefaultMachine;
+        peephole = new GCodePeephole(gcode->file, config ? config->machine
+                                     : kDefaultMachine, gcode_rewrites);
+        gcode->printer->output()->SetFilter(peephole);
+        rewritten_output = gcode - outputs.begin();
+    }
+
+    MultiPrinter *printers = new MultiPrinter();
+    for (const Output &output : outputs) {
+        printers->Add(output.printer, output.own_thread);
+    }
+
+    const auto output_start = std::chrono::steady_clock::now();
+    printers->Init(board.dimension());
 
-    // Feed all the parts to the printer.
-    for (const Part* part : board.parts()) {
-        printer->PrintPart(*part);
+    // Feed all the parts to the printers.
+    for (int part : route) {
+        printers->PrintPart(board.parts().part(part));
     }
 
-    printer->Finish();
+    printers->Finish();
+    if (peephole) {
+        peephole->Finish();
+        peephole->PrintReport(stderr);
+    }
+    if (print_stats) {
+        const std::chrono::duration<double> duration
+            = std::chrono::steady_clock::now() - output_start;
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            const Output &output = outputs[i];
+            // The rewritten G-code is what ends up in the file.
+            const OutputBuffer *written = (i == rewritten_output)
+                ? &peephole->output() : output.printer->output();
+            const size_t lines = written->lines();
+            const double seconds = printers->seconds(i);
+            fprintf(stderr, "Output%s%s: %zu lines, %zu kiB in %.1fms "
+                    "(%.0f lines/s)\n", output.spec ? " " : "",
+                    output.spec ? output.spec : "", lines,
+                    written->bytes() >> 10, seconds * 1000,
+                    seconds > 0 ? lines / seconds : 0);
+        }
+        fprintf(stderr, "All outputs done in %.1fms\n",
+                duration.count() * 1000);
+    }
 
-    delete printer;
+    delete printers;
+    delete peephole;
+    for (const Output &output : outputs) {
+        if (output.file != stdout) fclose(output.file);
+    }
     return 0;
 }
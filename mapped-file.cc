@@ -0,0 +1,47 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "mapped-file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : data_(NULL), size_(0) {}
+
+MappedFile::~MappedFile() {
+    if (data_ && size_ > 0) munmap((void*) data_, size_);
+}
+
+bool MappedFile::Map(const std::string& filename) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Can't open %s\n", filename.c_str());
+        return false;
+    }
+    struct stat s;
+    if (fstat(fd, &s) != 0) {
+        perror(filename.c_str());
+        close(fd);
+        return false;
+    }
+    size_ = s.st_size;
+    if (size_ == 0) {   // mmap() doesn't like empty files.
+        close(fd);
+        data_ = "";
+        return true;
+    }
+    void *mapped = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        perror(filename.c_str());
+        size_ = 0;
+        return false;
+    }
+    madvise(mapped, size_, MADV_SEQUENTIAL);
+    data_ = (const char*) mapped;
+    return true;
+}
@@ -0,0 +1,32 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Read-only memory mapped file.
+ */
+#ifndef PNP_MAPPED_FILE_H
+#define PNP_MAPPED_FILE_H
+
+#include <stddef.h>
+#include <string>
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Map the given file. Returns 'false' and prints a message to stderr if
+    // that didn't work.
+    bool Map(const std::string& filename);
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char *data_;
+    size_t size_;
+};
+
+#endif  // PNP_MAPPED_FILE_H
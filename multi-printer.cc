@@ -0,0 +1,125 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "multi-printer.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Parts are handed to a thread this many at a time, so that it doesn't
+// take a lock for each one.
+static const size_t kChunkSize = 256;
+
+MultiPrinter::MultiPrinter(int queue_parts)
+    : max_chunks_(std::max<size_t>(1, queue_parts / kChunkSize)) {}
+
+MultiPrinter::~MultiPrinter() {
+    for (Worker *w : workers_) {
+        if (w->thread.joinable()) {
+            // Not finished; let the thread wind down before deleting.
+            Event finish;
+            finish.kind = Event::FINISH;
+            w->outgoing.push_back(finish);
+            Enqueue(w);
+            w->thread.join();
+        }
+        delete w->printer;
+        delete w;
+    }
+}
+
+void MultiPrinter::Add(Printer *printer, bool own_thread) {
+    Worker *w = new Worker();
+    w->printer = printer;
+    w->seconds = 0;
+    if (own_thread) {
+        w->outgoing.reserve(kChunkSize);
+        w->thread = std::thread(&MultiPrinter::Run, w);
+    }
+    workers_.push_back(w);
+}
+
+void MultiPrinter::Init(const Dimension& dimension) {
+    Event event;
+    event.kind = Event::INIT;
+    event.dimension = dimension;
+    Send(event);
+}
+
+void MultiPrinter::PrintPart(const Part &part) {
+    Event event;
+    event.kind = Event::PART;
+    event.part = part;
+    Send(event);
+}
+
+void MultiPrinter::Finish() {
+    Event event;
+    event.kind = Event::FINISH;
+    Send(event);
+    for (Worker *w : workers_) {
+        if (w->thread.joinable()) w->thread.join();
+    }
+}
+
+void MultiPrinter::Send(const Event &event) {
+    for (Worker *w : workers_) {
+        if (!w->thread.joinable()) {
+            Dispatch(w, event);
+            continue;
+        }
+        w->outgoing.push_back(event);
+        if (w->outgoing.size() >= kChunkSize || event.kind != Event::PART) {
+            Enqueue(w);
+        }
+    }
+}
+
+void MultiPrinter::Enqueue(Worker *w) {
+    std::unique_lock<std::mutex> lock(w->mutex);
+    w->changed.wait(lock, [this, w]() {
+            return w->queue.size() < max_chunks_; });
+    w->queue.push_back(Chunk());
+    w->queue.back().swap(w->outgoing);
+    lock.unlock();
+    w->changed.notify_all();
+    w->outgoing.reserve(kChunkSize);
+}
+
+void MultiPrinter::Run(Worker *w) {
+    for (;;) {
+        Chunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(w->mutex);
+            w->changed.wait(lock, [w]() { return !w->queue.empty(); });
+            chunk.swap(w->queue.front());
+            w->queue.pop_front();
+        }
+        w->changed.notify_all();   // Room for the next chunk.
+        for (const Event &event : chunk) {
+            if (!Dispatch(w, event))
+                return;
+        }
+    }
+}
+
+bool MultiPrinter::Dispatch(Worker *w, const Event &event) {
+    const auto start = std::chrono::steady_clock::now();
+    switch (event.kind) {
+    case Event::INIT:
+        w->printer->Init(event.dimension);
+        break;
+    case Event::PART:
+        w->printer->PrintPart(event.part);
+        break;
+    case Event::FINISH:
+        w->printer->Finish();
+        w->printer->output()->Flush();
+        break;
+    }
+    const std::chrono::duration<double> duration
+        = std::chrono::steady_clock::now() - start;
+    w->seconds += duration.count();
+    return event.kind != Event::FINISH;
+}
@@ -0,0 +1,72 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Several printers fed from one pass over the parts, e.g. the G-code and a
+ * PostScript preview of the same route.
+ */
+#ifndef PNP_MULTI_PRINTER_H
+#define PNP_MULTI_PRINTER_H
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "printer.h"
+
+// Passes everything on to each of its printers, in the order they were
+// added. A printer can have a thread of its own; it then gets the parts
+// through a bounded queue, so it only holds up the others once that is full.
+class MultiPrinter {
+public:
+    // Threads are at most "queue_parts" parts behind.
+    explicit MultiPrinter(int queue_parts = 4096);
+    ~MultiPrinter();   // Deletes the printers.
+
+    // Add "printer", taking ownership.
+    void Add(Printer *printer, bool own_thread);
+
+    void Init(const Dimension& dimension);
+    void PrintPart(const Part &part);
+
+    // Finish all printers and flush their output. Waits for the threads.
+    void Finish();
+
+    // Seconds the "index"th printer added spent printing and writing; on
+    // its own thread, without waiting for parts.
+    double seconds(size_t index) const { return workers_[index]->seconds; }
+
+private:
+    struct Event {
+        enum Kind { INIT, PART, FINISH } kind;
+        Dimension dimension;
+        Part part;
+    };
+    typedef std::vector<Event> Chunk;
+
+    // A printer and, if it has its own thread, what is queued for it.
+    struct Worker {
+        Printer *printer;
+        double seconds;                 // Spent in the printer.
+        std::thread thread;
+        Chunk outgoing;                 // Not queued yet; sent in chunks.
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Chunk> queue;
+    };
+
+    void Send(const Event &event);
+    void Enqueue(Worker *worker);
+    static void Run(Worker *worker);
+
+    // Returns false once the printer has finished.
+    static bool Dispatch(Worker *worker, const Event &event);
+
+    const size_t max_chunks_;
+    std::vector<Worker*> workers_;
+};
+
+#endif  // PNP_MULTI_PRINTER_H
@@ -0,0 +1,75 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Time ParseFloat() against the stream extraction in SlowParseFloat() on
+ * the numbers of a file, e.g. an rpt file.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "mapped-file.h"
+#include "number-parser.h"
+
+typedef bool (*ParseFunction)(const char *str, size_t len, float *result);
+
+struct Word {
+    const char *str;
+    size_t len;
+};
+
+// Nanoseconds per word; sums up the results so they are not optimized away.
+static double Time(ParseFunction parse, const std::vector<Word> &words,
+                   int rounds, double *sum) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const Word &w : words) {
+            float value;
+            if (parse(w.str, w.len, &value)) *sum += value;
+        }
+    }
+    const std::chrono::duration<double> duration
+        = std::chrono::steady_clock::now() - start;
+    return duration.count() * 1e9 / (rounds * words.size());
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file> [<rounds>]\n", argv[0]);
+        return 1;
+    }
+    const int rounds = argc > 2 ? atoi(argv[2]) : 20;
+    MappedFile file;
+    if (!file.Map(argv[1]))
+        return 1;
+
+    std::vector<Word> words;
+    const char *pos = file.data();
+    const char *const end = pos + file.size();
+    while (pos < end) {
+        while (pos < end && isspace(*pos)) ++pos;
+        const char *start = pos;
+        while (pos < end && !isspace(*pos)) ++pos;
+        const Word found = { start, (size_t)(pos - start) };
+        float value;
+        if (found.len > 0 && SlowParseFloat(found.str, found.len, &value)) {
+            words.push_back(found);
+        }
+    }
+    if (words.empty() || rounds < 1) {
+        fprintf(stderr, "No numbers in %s\n", argv[1]);
+        return 1;
+    }
+
+    double sum = 0;
+    const double slow_ns = Time(&SlowParseFloat, words, rounds, &sum);
+    const double fast_ns = Time(&ParseFloat, words, rounds, &sum);
+    printf("%zu numbers, %d rounds: istream %.1fns, ParseFloat %.1fns per "
+           "number (%.1fx) [%g]\n", words.size(), rounds, slow_ns, fast_ns,
+           slow_ns / fast_ns, sum);
+    return 0;
+}
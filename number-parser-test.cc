@@ -0,0 +1,95 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Check that ParseFloat() gives bit for bit what the stream extraction in
+ * SlowParseFloat() gives: for every word of the given files, for some
+ * corner cases and for random plain decimals.
+ */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+
+#include "mapped-file.h"
+#include "number-parser.h"
+
+static int failures = 0;
+
+// Returns true if "str" is a number.
+static bool Check(const char *str, size_t len) {
+    float fast = 0, slow = 0;
+    const bool fast_ok = ParseFloat(str, len, &fast);
+    const bool slow_ok = SlowParseFloat(str, len, &slow);
+    if (fast_ok != slow_ok
+        || (fast_ok && memcmp(&fast, &slow, sizeof(float)) != 0)) {
+        if (++failures <= 20) {
+            fprintf(stderr, "'%.*s': ParseFloat %s %.9g, "
+                    "SlowParseFloat %s %.9g\n", (int)len, str,
+                    fast_ok ? "ok" : "fails", fast,
+                    slow_ok ? "ok" : "fails", slow);
+        }
+    }
+    return slow_ok;
+}
+
+static bool Check(const std::string &str) {
+    return Check(str.data(), str.size());
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file>...\n", argv[0]);
+        return 1;
+    }
+    int numbers = 0;
+    for (int i = 1; i < argc; ++i) {
+        MappedFile file;
+        if (!file.Map(argv[i]))
+            return 1;
+        const char *pos = file.data();
+        const char *const end = pos + file.size();
+        while (pos < end) {
+            while (pos < end && isspace(*pos)) ++pos;
+            const char *word = pos;
+            while (pos < end && !isspace(*pos)) ++pos;
+            if (pos > word && Check(word, pos - word)) ++numbers;
+        }
+    }
+
+    static const char *const kCornerCases[] = {
+        "0", "-0", "+1", "0.000000", "-0.108300", ".5", "5.", "1e3",
+        "1.5E-7", "16777216", "16777217", "0.16777217", "3.4028235e38",
+        "1e39", "1234567890123456789", "12345678901234567890", "0.1",
+        "9999999999", "0.0000000001", "00000000000000000000001", "inf",
+        "nan", "-", ".", "1.2.3", "1-2", "abc",
+    };
+    for (const char *str : kCornerCases) {
+        if (Check(str, strlen(str))) ++numbers;
+    }
+
+    // Plain decimals as KiCad writes them, and some longer ones.
+    std::mt19937 rng(42);
+    for (int i = 0; i < 1000000; ++i) {
+        const int int_digits = rng() % 8;
+        const int frac_digits = rng() % 9;
+        std::string str = (rng() % 2) ? "-" : "";
+        for (int d = 0; d < int_digits; ++d) str.push_back('0' + rng() % 10);
+        if (frac_digits > 0 || int_digits == 0) {
+            str.push_back('.');
+            for (int d = 0; d <= frac_digits; ++d)
+                str.push_back('0' + rng() % 10);
+        }
+        if (Check(str)) ++numbers;
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "FAIL: %d of %d numbers differ.\n", failures, numbers);
+        return 1;
+    }
+    printf("PASS: %d numbers bit-identical.\n", numbers);
+    return 0;
+}
@@ -0,0 +1,77 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "number-parser.h"
+
+#include <stdint.h>
+
+#include <locale>
+#include <sstream>
+#include <string>
+
+// Powers of ten that are exactly representable as float (5^10 < 2^24).
+static const float kPow10[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+static const int kMaxPow10 = sizeof(kPow10) / sizeof(kPow10[0]) - 1;
+
+// Largest integer up to which all integers are exactly representable as float.
+static const uint64_t kMaxExactMantissa = 1 << 24;
+
+bool SlowParseFloat(const char *str, size_t len, float *result) {
+    std::istringstream in(std::string(str, len));
+    in.imbue(std::locale::classic());
+    in >> *result;
+    return !in.fail();
+}
+
+bool ParseFloat(const char *str, size_t len, float *result) {
+    const char *pos = str;
+    const char *const end = str + len;
+    bool negative = false;
+    if (pos < end && (*pos == '-' || *pos == '+')) {
+        negative = (*pos == '-');
+        ++pos;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;       // decimal exponent
+    int digits = 0;
+    bool seen_dot = false;
+    for (/**/; pos < end; ++pos) {
+        const char c = *pos;
+        if (c >= '0' && c <= '9') {
+            if (++digits > 19)  // Don't overflow the mantissa.
+                return SlowParseFloat(str, len, result);
+            mantissa = 10 * mantissa + (c - '0');
+            if (seen_dot) --exponent;
+        } else if (c == '.' && !seen_dot) {
+            seen_dot = true;
+        } else {
+            break;
+        }
+    }
+    if (pos != end || digits == 0)   // Exponent, inf, nan or garbage.
+        return SlowParseFloat(str, len, result);
+
+    // Trailing zeros in the fraction just make the mantissa longer.
+    while (exponent < 0 && mantissa != 0 && mantissa % 10 == 0) {
+        mantissa /= 10;
+        ++exponent;
+    }
+
+    // Both, mantissa and power of ten are exact. The single division or
+    // multiplication then is correctly rounded; same as strtof() would do.
+    if (mantissa > kMaxExactMantissa
+        || exponent < -kMaxPow10 || exponent > kMaxPow10) {
+        return SlowParseFloat(str, len, result);
+    }
+    float value = (float) mantissa;
+    if (exponent < 0)
+        value /= kPow10[-exponent];
+    else
+        value *= kPow10[exponent];
+    *result = negative ? -value : value;
+    return true;
+}
@@ -0,0 +1,23 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Fast, locale independent number parsing.
+ */
+#ifndef PNP_NUMBER_PARSER_H
+#define PNP_NUMBER_PARSER_H
+
+#include <stddef.h>
+
+// Parse a float from the "len" characters at "str", which does not need to
+// be nul-terminated. Plain decimals such as KiCad writes them ("-0.108300")
+// are converted directly; anything else (exponents, very long mantissas)
+// falls back to the classic-locale stream extraction. Either way the result
+// is bit-identical to "std::istream >> float".
+// Returns 'false' if this is not a number.
+bool ParseFloat(const char *str, size_t len, float *result);
+
+// Same, always with the classic-locale stream extraction. What ParseFloat()
+// is compared against.
+bool SlowParseFloat(const char *str, size_t len, float *result);
+
+#endif  // PNP_NUMBER_PARSER_H
@@ -1,8 +1,7 @@
 /* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
  * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
- * Optimization for dispensing stuff.
- * Not really used right now; used to be for pads, doesn't make much sense for
- * parts.
+ * Route through the parts: nearest neighbor to start with, then improved by
+ * 2-opt and Or-opt local search, on several threads within a time budget.
  */
 
 #include "rpt2pnp.h"
@@ -10,37 +9,509 @@
 #include <math.h>
 #include <unistd.h>
 
-#include "board.h"  // definition of Part
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "board.h"  // definition of PartTable
+#include "spatial-index.h"
 
 static float euklid(float a, float b) { return sqrtf(a*a + b*b); }
 float Distance(const Position& a, const Position& b) {
     return euklid(a.x - b.x, a.y - b.y);
 }
-static void Swap(std::vector<const Part*> *parts, size_t i, size_t j) {
-    const Part* tmp = (*parts)[i];
-    (*parts)[i] = (*parts)[j];
-    (*parts)[j] = tmp;
+
+float ShortestRotation(float from, float to) {
+    return remainderf(to - from, 360.0f);
 }
 
-static int FindSmallestDistance(const std::vector<const Part*> parts,
-                                size_t range_start,
-                                const Position &reference_pos) {
-    float smallest_distance;
-    int best = -1;
-    for (size_t j = range_start; j < parts.size(); ++j) {
-        float distance = Distance(reference_pos, parts[j]->pos);
-        if (best < 0 || distance < smallest_distance) {
-            best = j;
-            smallest_distance = distance;
-        }
+// Very crude optimization looking for nearest neighbor. Not TSP, but better than random
+void OptimizeParts(const PartTable &parts, std::vector<int> *order) {
+    if (order->size() < 2)
+        return;
+    // Index over the parts in the order given; IDs are positions in "order"
+    std::vector<float> xs, ys;
+    xs.reserve(order->size());
+    ys.reserve(order->size());
+    for (int i : *order) {
+        xs.push_back(parts.x()[i]);
+        ys.push_back(parts.y()[i]);
     }
-    return best;
+    SpatialIndex remaining(xs.data(), ys.data(), xs.size());
+    std::vector<int> route;
+    route.reserve(order->size());
+    int current = 0;
+    for (;;) {
+        route.push_back((*order)[current]);
+        remaining.Remove(current);
+        if (remaining.remaining() == 0)
+            break;
+        current = remaining.FindNearest(Position(xs[current], ys[current]));
+    }
+    order->swap(route);
 }
 
-// Very crude, O(n^2) optimization looking for nearest neighbor. Not TSP, but better than random
-void OptimizeParts(std::vector<const Part*> *parts) {
-    for (size_t i = 0; i < parts->size() - 1; ++i) {
-        Swap(parts, i + 1, FindSmallestDistance(*parts, i + 1, (*parts)[i]->pos));
+float RouteLength(const PartTable &parts, const std::vector<int> &order) {
+    double length = 0;
+    for (size_t i = 1; i < order.size(); ++i) {
+        length += Distance(parts.pos(order[i-1]), parts.pos(order[i]));
     }
+    return length;
 }
 
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// Improvement needs to be at least that, so that rounding noise can't
+// make us go in circles.
+static constexpr double kEpsilon = 1e-6;
+
+// For each point, its nearest neighbors. Shared read-only between threads.
+class NeighborLists {
+public:
+    static const int kNeighbors = 8;
+
+    NeighborLists(const std::vector<float> &xs, const std::vector<float> &ys)
+        : neighbors_(xs.size() * kNeighbors, -1) {
+        const SpatialIndex index(xs.data(), ys.data(), xs.size());
+        std::vector<int> nearest;
+        for (size_t p = 0; p < xs.size(); ++p) {
+            index.FindKNearest(Position(xs[p], ys[p]), kNeighbors + 1,
+                               &nearest);
+            // With more than kNeighbors points at the same spot, "p" itself
+            // need not be among them; don't overrun its kNeighbors slots.
+            int *out = &neighbors_[p * kNeighbors];
+            int *const out_end = out + kNeighbors;
+            for (int other : nearest) {
+                if (out == out_end) break;
+                if (other != (int)p) *out++ = other;
+            }
+        }
+    }
+
+    // kNeighbors entries, -1 padded.
+    const int *of(int p) const { return &neighbors_[p * kNeighbors]; }
+
+private:
+    std::vector<int> neighbors_;
+};
+
+// Local search on a route with fixed start, using 2-opt and Or-opt
+// moves. To keep things fast, candidate moves only ever create edges from a
+// point to one of its nearest neighbors, and only points next to a changed
+// edge are looked at again.
+// The route can be a section of a larger route, with a fixed end as well;
+// neighbors outside of the section are ignored.
+// All changes to the route can be logged and undone, so that a perturbation
+// that did not lead to a better route can be rolled back cheaply.
+class LocalSearch {
+public:
+    LocalSearch(const std::vector<float> &xs, const std::vector<float> &ys,
+                const NeighborLists &neighbors)
+        : xs_(xs), ys_(ys), neighbors_(neighbors), n_(0), last_(-1),
+          pos_(xs.size(), -1), queued_(xs.size(), false), logging_(false),
+          since_clock_check_(0) {}
+
+    // Set route [begin, end) to work on. If "fixed_end", the last point
+    // stays where it is.
+    void SetRoute(std::vector<int>::const_iterator begin,
+                  std::vector<int>::const_iterator end, bool fixed_end) {
+        for (int p : route_) pos_[p] = -1;
+        route_.assign(begin, end);
+        n_ = route_.size();
+        last_ = fixed_end ? n_ - 2 : n_ - 1;
+        UpdatePositions(0, n_ - 1);
+    }
+    const std::vector<int> &route() const { return route_; }
+
+    void QueueAll() {
+        for (int p : route_) Queue(p);
+    }
+
+    // Apply improving moves until there are none left or the deadline
+    // is reached. Returns the change in route length, or NAN if the
+    // deadline was hit.
+    double Optimize(const Clock::time_point &deadline) {
+        double delta = 0;
+        while (!queue_.empty()) {
+            if (++since_clock_check_ == 64) {
+                since_clock_check_ = 0;
+                if (Clock::now() >= deadline)
+                    return NAN;
+            }
+            const int p = queue_.front();
+            queue_.pop_front();
+            queued_[p] = false;
+            const int i = pos_[p];
+            double gain = TwoOpt(i);
+            for (int len = 1; len <= 3 && gain == 0; ++len) {
+                gain = OrOpt(i, len);
+            }
+            if (gain != 0) {
+                delta += gain;
+                Queue(p);
+            }
+        }
+        return delta;
+    }
+
+    // Perturbation: swap two adjacent segments of up to kMaxSegment points
+    // at a random place, a variant of the double-bridge move that keeps the
+    // start of the route. Returns the change in route length.
+    double Kick(std::mt19937 *rng) {
+        static const int kMaxSegment = 50;
+        if (last_ < 2) return 0;
+        const int s = 1 + (*rng)() % (last_ - 1);    // at least two left.
+        const int max_len = std::min(kMaxSegment, (last_ - s + 1) / 2);
+        const int len_b = 1 + (*rng)() % max_len;
+        const int len_c = 1 + (*rng)() % max_len;
+        const int a = route_[s - 1];
+        const int b0 = route_[s], b1 = route_[s + len_b - 1];
+        const int c0 = route_[s + len_b], c1 = route_[s + len_b + len_c - 1];
+        const int d = (s + len_b + len_c < n_) ? route_[s + len_b + len_c] : -1;
+        double delta = D(a, c0) + D(c1, b0) - D(a, b0) - D(b1, c0);
+        if (d >= 0)
+            delta += D(b1, d) - D(c1, d);
+        Rotate(s, s + len_b, s + len_b + len_c);
+        for (int p : { a, b0, b1, c0, c1, d }) {
+            if (p >= 0) Queue(p);
+        }
+        return delta;
+    }
+
+    // Start logging changes, so that they can be undone with Undo().
+    void StartLog() { log_.clear(); logging_ = true; }
+    void Undo() {
+        logging_ = false;
+        while (!log_.empty()) {
+            const Op &op = log_.back();
+            if (op.reverse)
+                Reverse(op.first, op.last - 1);
+            else
+                Rotate(op.first, op.first + (op.last - op.middle), op.last);
+            log_.pop_back();
+        }
+        while (!queue_.empty()) {
+            queued_[queue_.front()] = false;
+            queue_.pop_front();
+        }
+    }
+
+private:
+    // A logged route change: either reversal of [first, last) or std::rotate.
+    struct Op {
+        bool reverse;
+        int first, middle, last;
+    };
+
+    double D(int a, int b) const {
+        const double dx = xs_[a] - xs_[b];
+        const double dy = ys_[a] - ys_[b];
+        return sqrt(dx * dx + dy * dy);
+    }
+
+    void Queue(int p) {
+        if (queued_[p]) return;
+        queued_[p] = true;
+        queue_.push_back(p);
+    }
+
+    // 2-opt: connect the point at route position i with one of its
+    // neighbors by reversing the route segment in between.
+    // Returns the (negative) change in length or 0 if nothing changed.
+    double TwoOpt(int i) {
+        const int a = route_[i];
+        const int *neighbors = neighbors_.of(a);
+        for (int k = 0; k < NeighborLists::kNeighbors; ++k) {
+            const int c = neighbors[k];
+            if (c < 0) break;
+            const int p = pos_[c];
+            if (p < 0) continue;   // Not in our section.
+            if (p > i + 1 && p <= last_) {
+                // a->b ... c->e  becomes  a->c ... b->e
+                const int b = route_[i + 1];
+                const int e = (p + 1 < n_) ? route_[p + 1] : -1;
+                double delta = D(a, c) - D(a, b);
+                if (e >= 0)
+                    delta += D(b, e) - D(c, e);
+                if (delta < -kEpsilon) {
+                    Reverse(i + 1, p);
+                    Queue(b); Queue(c);
+                    if (e >= 0) Queue(e);
+                    return delta;
+                }
+            } else if (p + 1 < i && i <= last_) {
+                // c->f ... a->b  becomes  c->a ... f->b
+                const int f = route_[p + 1];
+                const int b = (i + 1 < n_) ? route_[i + 1] : -1;
+                double delta = D(c, a) - D(c, f);
+                if (b >= 0)
+                    delta += D(f, b) - D(a, b);
+                if (delta < -kEpsilon) {
+                    Reverse(p + 1, i);
+                    Queue(c); Queue(f);
+                    if (b >= 0) Queue(b);
+                    return delta;
+                }
+            }
+        }
+        return 0;
+    }
+
+    // Or-opt: move the segment of "len" points starting at route position s
+    // (possibly reversed) next to a neighbor of one of its ends.
+    // Returns the (negative) change in length or 0 if nothing changed.
+    double OrOpt(int s, int len) {
+        if (s < 1 || s + len - 1 > last_)
+            return 0;   // Start and end are fixed.
+        const int first = route_[s];
+        const int last = route_[s + len - 1];
+        const int prev = route_[s - 1];
+        const int next = (s + len < n_) ? route_[s + len] : -1;
+        double removal_gain = D(prev, first);
+        if (next >= 0)
+            removal_gain += D(last, next) - D(prev, next);
+
+        for (const int end : { first, last }) {
+            const int *neighbors = neighbors_.of(end);
+            for (int k = 0; k < NeighborLists::kNeighbors; ++k) {
+                const int c = neighbors[k];
+                if (c < 0) break;
+                const int p = pos_[c];
+                if (p < 0 || (p >= s - 1 && p < s + len))
+                    continue;   // in segment or already in front of it.
+                if (p > last_ && p == n_ - 1)
+                    continue;   // Can't append after fixed end.
+                // Insert between c and its successor.
+                const int succ = (p + 1 < n_) ? route_[p + 1] : -1;
+                double forward = D(c, first);
+                double reverse = D(c, last);
+                if (succ >= 0) {
+                    forward += D(last, succ) - D(c, succ);
+                    reverse += D(first, succ) - D(c, succ);
+                }
+                const bool reversed = reverse < forward;
+                const double delta
+                    = (reversed ? reverse : forward) - removal_gain;
+                if (delta < -kEpsilon) {
+                    MoveSegment(s, len, p, reversed);
+                    Queue(prev); Queue(first); Queue(last); Queue(c);
+                    if (next >= 0) Queue(next);
+                    if (succ >= 0) Queue(succ);
+                    return delta;
+                }
+            }
+        }
+        return 0;
+    }
+
+    void Reverse(int from, int to) {   // inclusive
+        std::reverse(route_.begin() + from, route_.begin() + to + 1);
+        UpdatePositions(from, to);
+        if (logging_) log_.push_back({ true, from, 0, to + 1 });
+    }
+
+    // std::rotate() on the route positions.
+    void Rotate(int first, int middle, int last) {
+        std::rotate(route_.begin() + first, route_.begin() + middle,
+                    route_.begin() + last);
+        UpdatePositions(first, last - 1);
+        if (logging_) log_.push_back({ false, first, middle, last });
+    }
+
+    // Move segment [s, s + len) to just after position p.
+    void MoveSegment(int s, int len, int p, bool reversed) {
+        if (p < s) {
+            Rotate(p + 1, s, s + len);
+            if (reversed) Reverse(p + 1, p + len);
+        } else {
+            Rotate(s, s + len, p + 1);
+            if (reversed) Reverse(p - len + 1, p);
+        }
+    }
+
+    void UpdatePositions(int from, int to) {
+        for (int i = from; i <= to; ++i) pos_[route_[i]] = i;
+    }
+
+    const std::vector<float> &xs_;
+    const std::vector<float> &ys_;
+    const NeighborLists &neighbors_;
+    int n_;
+    int last_;                     // Last position that can be moved.
+    std::vector<int> route_;
+    std::vector<int> pos_;         // point -> position in route.
+    std::vector<bool> queued_;
+    std::deque<int> queue_;        // points to look at.
+    bool logging_;
+    std::vector<Op> log_;
+    int since_clock_check_;        // Look at the clock only every so often.
+};
+
+// Each round, the route is cut into sections that are improved
+// independently by iterated local search, each section keeping its start
+// and end point; the improved sections then are put back together.
+// There are a few more sections than threads: each thread starts with its
+// own share and steals from the others once it is done. The cut points move
+// every round, so that sections overlap previous boundaries.
+// A section's result only depends on the seed, round and section, so the
+// outcome is the same no matter which thread ran which section.
+class ParallelImprover {
+public:
+    static const int kSectionsPerThread = 2;
+    static const int kMinSectionSize = 256;
+
+    ParallelImprover(const std::vector<float> &xs,
+                     const std::vector<float> &ys,
+                     const NeighborLists &neighbors, int threads,
+                     unsigned seed)
+        : threads_(threads), seed_(seed), next_section_(threads) {
+        for (int t = 0; t < threads; ++t) {
+            searches_.emplace_back(new LocalSearch(xs, ys, neighbors));
+        }
+    }
+
+    // Run one round on "route". Returns false if the deadline was hit
+    // before the round was finished; in that case "route" is not changed.
+    bool Round(int round, const Clock::time_point &deadline,
+               std::vector<int> *route) {
+        const int n = route->size();
+        const int sections = std::max(1, std::min(threads_ * kSectionsPerThread,
+                                                  n / kMinSectionSize));
+        const int size = n / sections;
+        std::mt19937 rng(seed_ + round);
+        const int shift = rng() % size;
+        cuts_.clear();
+        cuts_.push_back(0);
+        for (int s = 1; s < sections; ++s) {
+            cuts_.push_back(s * size + shift);
+        }
+        cuts_.push_back(n);
+        for (int t = 0; t < threads_; ++t) {
+            next_section_[t] = t * sections / threads_;
+        }
+
+        std::vector<int> result(n);
+        std::atomic<bool> deadline_hit(false);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threads_; ++t) {
+            threads.push_back(std::thread([&, t]() {
+                int section;
+                while (!deadline_hit
+                       && (section = TakeSection(t, sections)) >= 0) {
+                    if (!RunSection(searches_[t].get(), round, section,
+                                    *route, deadline, &result)) {
+                        deadline_hit = true;
+                    }
+                }
+            }));
+        }
+        for (std::thread &t : threads) t.join();
+        if (deadline_hit)
+            return false;
+
+        route->swap(result);
+        return true;
+    }
+
+private:
+    // Take the next section of thread t, or steal one of another thread.
+    // Returns -1 if there is none left.
+    int TakeSection(int t, int sections) {
+        for (int i = 0; i < threads_; ++i) {
+            const int victim = (t + i) % threads_;
+            const int end = (victim + 1) * sections / threads_;
+            if (next_section_[victim] >= end)
+                continue;
+            const int section = next_section_[victim]++;
+            if (section < end)
+                return section;
+        }
+        return -1;
+    }
+
+    // Iterated local search on a section: kick, optimize, keep if better.
+    // Writes the section to "result". Returns false if the deadline was hit.
+    bool RunSection(LocalSearch *search, int round, int section,
+                    const std::vector<int> &route,
+                    const Clock::time_point &deadline,
+                    std::vector<int> *result) {
+        const int begin = cuts_[section];
+        const int end = cuts_[section + 1];
+        const bool fixed_end = end < (int)route.size();
+        search->SetRoute(route.begin() + begin,
+                         route.begin() + end + (fixed_end ? 1 : 0),
+                         fixed_end);
+        std::mt19937 rng(seed_ ^ (round * 7919 + section * 104729));
+        const int kicks = (end - begin) / 4;
+        for (int k = 0; k < kicks; ++k) {
+            search->StartLog();
+            double change = search->Kick(&rng);
+            change += search->Optimize(deadline);
+            if (std::isnan(change))
+                return false;
+            if (change >= -kEpsilon)
+                search->Undo();
+        }
+        std::copy(search->route().begin(), search->route().begin()
+                  + (end - begin), result->begin() + begin);
+        return true;
+    }
+
+    const int threads_;
+    const unsigned seed_;
+    std::vector<std::unique_ptr<LocalSearch>> searches_;
+    std::vector<int> cuts_;                    // Section boundaries.
+    std::vector<std::atomic<int>> next_section_;
+};
+}  // namespace
+
+int ImproveRoute(const PartTable &parts, const RouteOptions &options,
+                 std::vector<int> *order) {
+    const Clock::time_point deadline
+        = Clock::now() + std::chrono::milliseconds(options.budget_ms);
+    if (options.budget_ms <= 0 || order->size() < 4)
+        return 0;
+    // Work on local point IDs, i.e. position in the original order.
+    std::vector<float> xs, ys;
+    xs.reserve(order->size());
+    ys.reserve(order->size());
+    for (int i : *order) {
+        xs.push_back(parts.x()[i]);
+        ys.push_back(parts.y()[i]);
+    }
+    std::vector<int> route(order->size());
+    for (size_t i = 0; i < route.size(); ++i) route[i] = i;
+    const NeighborLists neighbors(xs, ys);
+
+    // Plain local search first; then perturbation rounds to get out of
+    // local minima.
+    LocalSearch search(xs, ys, neighbors);
+    search.SetRoute(route.begin(), route.end(), false);
+    search.QueueAll();
+    int rounds = 0;
+    if (!std::isnan(search.Optimize(deadline))) {
+        route = search.route();
+        ParallelImprover improver(xs, ys, neighbors,
+                                  std::max(1, options.threads), options.seed);
+        while ((options.max_rounds < 0 || rounds < options.max_rounds)
+               && improver.Round(rounds, deadline, &route)) {
+            ++rounds;
+        }
+    } else {
+        route = search.route();   // Deadline hit; best so far.
+    }
+
+    std::vector<int> result;
+    result.reserve(route.size());
+    for (int id : route) {
+        result.push_back((*order)[id]);
+    }
+    order->swap(result);
+    return rounds;
+}
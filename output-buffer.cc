@@ -0,0 +1,202 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "output-buffer.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+static const int kMaxFastDecimals = 6;
+static const uint64_t kPow10[kMaxFastDecimals + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+// Write the decimal digits of "value" backwards, ending at "end".
+// Returns the start.
+char *FormatUnsigned(uint64_t value, char *end) {
+    do {
+        *--end = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    return end;
+}
+
+// Format float "f" with "decimals" digits after the point to "out"; returns
+// length or -1 if it is out of the range handled here. A float is
+// m * 2^e with a 24 bit mantissa m, so value * 10^decimals can be
+// calculated exactly in 64 bit integers and rounded like printf does:
+// to nearest, ties to even.
+int FormatFixedFloat(float f, int decimals, char *out) {
+    int exponent;
+    const float mantissa = frexpf(fabsf(f), &exponent);
+    const uint64_t m = (uint64_t) ldexpf(mantissa, 24);
+    const int shift = 24 - exponent;   // value = m / 2^shift
+    const uint64_t scaled = m * kPow10[decimals];   // < 2^44
+    uint64_t q;
+    if (shift <= 0) {
+        if (shift < -19) return -1;    // Would not fit in 64 bit.
+        q = scaled << -shift;
+    } else if (shift >= 63) {
+        q = 0;   // scaled < half, rounds to zero.
+    } else {
+        q = scaled >> shift;
+        const uint64_t rest = scaled & ((uint64_t(1) << shift) - 1);
+        const uint64_t half = uint64_t(1) << (shift - 1);
+        if (rest > half || (rest == half && (q & 1)))
+            ++q;
+    }
+
+    char digits[32];
+    char *const end = digits + sizeof(digits);
+    char *start = FormatUnsigned(q / kPow10[decimals], end);
+    char *pos = out;
+    if (signbit(f)) *pos++ = '-';
+    memcpy(pos, start, end - start);
+    pos += end - start;
+    if (decimals > 0) {
+        *pos++ = '.';
+        start = FormatUnsigned(q % kPow10[decimals], end);
+        const int leading_zeros = decimals - (end - start);
+        memset(pos, '0', leading_zeros);
+        pos += leading_zeros;
+        memcpy(pos, start, end - start);
+        pos += end - start;
+    }
+    return pos - out;
+}
+}  // namespace
+
+OutputBuffer::OutputBuffer(FILE *out, size_t capacity)
+    : out_(out), filter_(NULL), capacity_(capacity), buffer_(new char[capacity]),
+      pos_(0), flushed_bytes_(0), flushed_lines_(0) {
+}
+
+OutputBuffer::~OutputBuffer() {
+    Flush();
+    delete [] buffer_;
+}
+
+void OutputBuffer::MakeRoom(size_t len) {
+    if (out_ != NULL || filter_ != NULL) {
+        Flush();
+        return;
+    }
+    capacity_ = std::max(2 * capacity_, pos_ + len);
+    char *const bigger = new char[capacity_];
+    memcpy(bigger, buffer_, pos_);
+    delete [] buffer_;
+    buffer_ = bigger;
+}
+
+void OutputBuffer::WriteOut(const char *data, size_t len) {
+    if (filter_)
+        filter_->Write(data, len);
+    else
+        fwrite(data, 1, len, out_);
+    flushed_lines_ += std::count(data, data + len, '\n');
+    flushed_bytes_ += len;
+}
+
+void OutputBuffer::Flush() {
+    if (pos_ == 0 || (out_ == NULL && filter_ == NULL))
+        return;
+    WriteOut(buffer_, pos_);
+    pos_ = 0;
+}
+
+size_t OutputBuffer::lines() const {
+    return flushed_lines_ + std::count(buffer_, buffer_ + pos_, '\n');
+}
+
+void OutputBuffer::Append(const char *str, size_t len) {
+    Reserve(len);
+    if (len > capacity_) {
+        WriteOut(str, len);
+        return;
+    }
+    memcpy(buffer_ + pos_, str, len);
+    pos_ += len;
+}
+
+void OutputBuffer::Append(const char *str) {
+    Append(str, strlen(str));
+}
+
+void OutputBuffer::AppendInt(int value) {
+    char digits[16];
+    char *const end = digits + sizeof(digits);
+    char *start = FormatUnsigned(value < 0 ? -(int64_t)value : value, end);
+    if (value < 0) *--start = '-';
+    Append(start, end - start);
+}
+
+void OutputBuffer::AppendFixed(double value, int decimals) {
+    char number[64];
+    int len = -1;
+    if (decimals >= 0 && decimals <= kMaxFastDecimals
+        && isfinite(value) && (double)(float)value == value) {
+        len = FormatFixedFloat(value, decimals, number);
+    }
+    if (len < 0) {
+        // Rare: doubles, huge numbers, inf and nan. Might not even fit
+        // here.
+        char *formatted = NULL;
+        len = asprintf(&formatted, "%.*f", decimals, value);
+        if (len > 0) Append(formatted, len);
+        free(formatted);
+        return;
+    }
+    Append(number, len);
+}
+
+void OutputBuffer::Printf(const char *format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    VPrintf(format, ap);
+    va_end(ap);
+}
+
+void OutputBuffer::VPrintf(const char *format, va_list ap) {
+    for (;;) {
+        const char *percent = strchr(format, '%');
+        if (percent == NULL) {
+            Append(format);
+            return;
+        }
+        Append(format, percent - format);
+        format = percent + 1;
+        int decimals = -1;
+        if (format[0] == '.' && format[1] >= '0' && format[1] <= '9') {
+            decimals = format[1] - '0';
+            format += 2;
+        }
+        const char conversion = *format++;
+        if (conversion == 'f') {
+            AppendFixed(va_arg(ap, double), decimals < 0 ? 6 : decimals);
+            continue;
+        }
+        if (decimals < 0) {
+            switch (conversion) {
+            case '%': Append("%", 1); continue;
+            case 's': Append(va_arg(ap, const char*)); continue;
+            case 'd': AppendInt(va_arg(ap, int)); continue;
+            }
+        }
+        // Anything else: leave the rest of the format to vasprintf().
+        char *formatted = NULL;
+        const int len = vasprintf(&formatted, percent, ap);
+        if (len < 0) {
+            fprintf(stderr, "OutputBuffer: can't format '%s'\n", percent);
+            abort();
+        }
+        Append(formatted, len);
+        free(formatted);
+        return;
+    }
+}
@@ -0,0 +1,75 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Buffered output for the printers, without going through stdio formatting
+ * for every number.
+ */
+#ifndef PNP_OUTPUT_BUFFER_H
+#define PNP_OUTPUT_BUFFER_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Receives what an OutputBuffer writes instead of its FILE, e.g. to rewrite
+// it. Chunks don't necessarily end at a line boundary.
+class OutputFilter {
+public:
+    virtual ~OutputFilter() {}
+    virtual void Write(const char *data, size_t len) = 0;
+};
+
+// Collects output in a large buffer that is written to "out" in big
+// chunks. The output is the same as if it was printed with printf().
+// Without "out", everything is kept in memory until appended to another
+// OutputBuffer; that way, output can be prepared on several threads.
+class OutputBuffer {
+public:
+    explicit OutputBuffer(FILE *out, size_t capacity = 1 << 20);
+    ~OutputBuffer();   // Flushes.
+
+    // Like printf(). %s, %d, %f, %.<n>f and %% are formatted without
+    // stdio; from any other conversion on, the rest goes to vasprintf().
+    void Printf(const char *format, ...)
+        __attribute__((format(printf, 2, 3)));
+    void VPrintf(const char *format, va_list ap);
+
+    void Append(const char *str, size_t len);
+    void Append(const char *str);
+    void AppendInt(int value);
+
+    // Append what has been collected in "other".
+    void Append(const OutputBuffer &other) {
+        Append(other.buffer_, other.pos_);
+    }
+
+    // Same as printf("%.<decimals>f", value). Values that are floats, which
+    // all our coordinates are, are converted exactly without stdio.
+    void AppendFixed(double value, int decimals);
+
+    // From now on, pass output to "filter" instead of "out".
+    void SetFilter(OutputFilter *filter) { Flush(); filter_ = filter; }
+
+    // Write out everything buffered so far. No-op without "out".
+    void Flush();
+
+    // Statistics: bytes and lines that went through this buffer.
+    size_t bytes() const { return flushed_bytes_ + pos_; }
+    size_t lines() const;
+
+private:
+    // Make sure there is room for "len" more bytes.
+    void Reserve(size_t len) { if (pos_ + len > capacity_) MakeRoom(len); }
+    void MakeRoom(size_t len);
+    void WriteOut(const char *data, size_t len);
+
+    FILE *const out_;
+    OutputFilter *filter_;
+    size_t capacity_;
+    char *buffer_;
+    size_t pos_;
+    size_t flushed_bytes_;
+    size_t flushed_lines_;
+};
+
+#endif  // PNP_OUTPUT_BUFFER_H
@@ -5,15 +5,34 @@
 #include "pnp-config.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <sstream>
 
-#include "tape.h"
+#include "feeder.h"
 #include "board.h"
 
+// Machine: parameters that are a plain number.
+static float *MachineValue(MachineModel *machine, const std::string &token) {
+    if (token == "xy-speed:") return &machine->xy_speed;
+    if (token == "xy-accel:") return &machine->xy_accel;
+    if (token == "z-speed:") return &machine->z_speed;
+    if (token == "z-accel:") return &machine->z_accel;
+    if (token == "rotation-speed:") return &machine->rotation_speed;
+    if (token == "rotation-accel:") return &machine->rotation_accel;
+    if (token == "hover:") return &machine->hover;
+    if (token == "hover-margin:") return &machine->hover_margin;
+    if (token == "approach-speed:") return &machine->approach_speed;
+    if (token == "approach-height:") return &machine->approach_height;
+    if (token == "blow-ms:") return &machine->blow_ms;
+    if (token == "min-z:") return &machine->min_z;
+    if (token == "clearance:") return &machine->clearance;
+    return NULL;
+}
+
 PnPConfig *ParsePnPConfiguration(const std::string& filename) {
     std::unique_ptr<PnPConfig> result(new PnPConfig());
 
@@ -22,7 +41,9 @@ PnPConfig *ParsePnPConfiguration(const std::string& filename) {
 
     std::string token;
     float x, y, z;
-    Tape* current_tape = NULL;
+    Feeder* current_tape = NULL;
+    Tray* current_tray = NULL;   // If current_tape is a tray.
+    bool nozzles_configured = false;
 
     std::ifstream in(filename);
     while (result && !in.eof()) {
@@ -35,18 +56,24 @@ PnPConfig *ParsePnPConfiguration(const std::string& filename) {
         if (token.empty() || token[0] == '#')
             continue;
 
-        if (token == "Board:") {
-            if (current_tape) current_tape = NULL;
-        } else if (token == "Tape:") {
-            current_tape = new Tape();
+        if (token == "Board:" || token == "Machine:") {
+            current_tape = NULL;
+            current_tray = NULL;
+        } else if (token == "Tape:" || token == "Tray:") {
+            if (token == "Tray:") {
+                current_tray = new Tray();
+                current_tape = current_tray;
+            } else {
+                current_tray = NULL;
+                current_tape = new Tape();
+            }
             // This tape is valid for multiple values/footprints possibly.
             // Lets all parse them
             token.clear();
             std::string all_the_names = buffer;
             std::stringstream parts(all_the_names);
-            while (!parts.eof()) {
-                parts >> token;
-                result->tape_for_component[token] = current_tape;
+            while (parts >> token) {
+                result->tape_for_component[token].push_back(current_tape);
             }
         } else if (token == "origin:") {
             if (current_tape) {
@@ -81,9 +108,9 @@ PnPConfig *ParsePnPConfiguration(const std::string& filename) {
                 result.reset(NULL);
             }
             current_tape->SetComponentSpacing(x, y);
-        } else if (token == "spacing:") {
+        } else if (token == "angle:") {
             if (!current_tape) {
-                std::cerr << "spacing without tape";
+                std::cerr << "angle without tape";
                 result.reset(NULL);
                 break;
             }
@@ -92,6 +119,71 @@ PnPConfig *ParsePnPConfiguration(const std::string& filename) {
                 result.reset(NULL);
             }
             current_tape->SetAngle(x);
+        } else if (float *value = MachineValue(&result->machine, token)) {
+            if (current_tape) {
+                fprintf(stderr, "%s belongs in the Machine: section.\n",
+                        token.c_str());
+                result.reset(NULL);
+                break;
+            }
+            // Everything needs to be positive; dwell and z can be zero.
+            if (1 != sscanf(buffer, "%f", value) || *value < 0
+                || (*value == 0 && value != &result->machine.blow_ms
+                    && value != &result->machine.min_z)) {
+                fprintf(stderr, "Parse problem %s '%s'\n", token.c_str(),
+                        buffer);
+                result.reset(NULL);
+                break;
+            }
+        } else if (token == "bed:") {
+            if (current_tape
+                || 2 != sscanf(buffer, "%f %f", &result->machine.bed.w,
+                               &result->machine.bed.h)) {
+                fprintf(stderr, "Parse problem bed: '%s'\n", buffer);
+                result.reset(NULL);
+                break;
+            }
+        } else if (token == "nozzle:") {
+            if (current_tape) {
+                fprintf(stderr, "nozzle: belongs in the Machine: section.\n");
+                result.reset(NULL);
+                break;
+            }
+            Nozzle nozzle;
+            const int fields = sscanf(buffer, "%f %f %d %d",
+                                      &nozzle.offset.x, &nozzle.offset.y,
+                                      &nozzle.vacuum_pin, &nozzle.blow_pin);
+            if (fields != 2 && fields != 4) {
+                fprintf(stderr, "Parse problem nozzle: '%s'\n", buffer);
+                result.reset(NULL);
+                break;
+            }
+            if (!nozzles_configured) {  // Replace the default nozzle.
+                result->machine.nozzles.clear();
+                nozzles_configured = true;
+            }
+            result->machine.nozzles.push_back(nozzle);
+        } else if (token == "part-height:") {
+            char footprint[256];
+            if (current_tape
+                || 2 != sscanf(buffer, "%255s %f", footprint, &x) || x < 0) {
+                fprintf(stderr, "Parse problem part-height: '%s' (needs "
+                        "<footprint> <mm>, not in a tape)\n", buffer);
+                result.reset(NULL);
+                break;
+            }
+            result->part_height[footprint] = x;
+        } else if (token == "grid:") {
+            int columns, rows;
+            if (!current_tray
+                || 2 != sscanf(buffer, "%d %d", &columns, &rows)
+                || columns <= 0 || rows <= 0) {
+                fprintf(stderr, "Parse problem grid: '%s' (needs Tray:)\n",
+                        buffer);
+                result.reset(NULL);
+                break;
+            }
+            current_tray->SetGrid(columns, rows);
         } else if (token == "count:") {
             if (!current_tape) {
                 std::cerr << "Count without tape.";
@@ -109,15 +201,31 @@ PnPConfig *ParsePnPConfiguration(const std::string& filename) {
     return result.release();
 }
 
+void ResolveComponentKeys(const PartTable &parts, PnPConfig *config) {
+    const StringTable &keys = parts.component_keys();
+    config->tapes_for_key.assign(keys.size(), std::vector<Feeder*>());
+    config->height_for_key.assign(keys.size(), -1);
+    for (int id = 0; id < keys.size(); ++id) {
+        auto found = config->tape_for_component.find(keys.str(id));
+        if (found != config->tape_for_component.end())
+            config->tapes_for_key[id] = found->second;
+        // Keys are <footprint>@<value>.
+        const char *key = keys.str(id);
+        const char *at = strchr(key, '@');
+        auto height = config->part_height.find(
+            at ? std::string(key, at - key) : std::string(key));
+        if (height != config->part_height.end())
+            config->height_for_key[id] = height->second;
+    }
+}
+
 static bool FindPartPos(const Board &board, const char *part_name,
                         Position *pos) {
-    for (const Part* part : board.parts()) {
-        if (part->component_name == part_name) {
-            *pos = part->pos;
-            return true;
-        }
-    }
-    return false;
+    const int part = board.FindPartByName(part_name);
+    if (part < 0)
+        return false;
+    *pos = board.parts().pos(part);
+    return true;
 }
 
 PnPConfig *ParseSimplePnPConfiguration(const Board &board,
@@ -137,19 +245,20 @@ PnPConfig *ParseSimplePnPConfiguration(const Board &board,
         if (5 == sscanf(buffer, "tape%d:%s %f %f %f\n", &tape_idx, designator,
                         &x, &y, &z)) {
             if (tape_idx == 1) {
+                // Another tape1 for the same component starts another tape.
                 Tape *t = new Tape();
                 t->SetFirstComponentPosition(x, y, z);
-                result->tape_for_component[designator] = t;
+                result->tape_for_component[designator].push_back(t);
             } else {
                 PnPConfig::PartToTape::iterator found;
                 found = result->tape_for_component.find(designator);
                 if (found != result->tape_for_component.end()) {
-                    Tape *t = found->second;
+                    Feeder *t = found->second.back();
                     const int advance = tape_idx - 1;
                     float old_x, old_y, old_z;
                     t->GetPos(&old_x, &old_y, &old_z);
-                    found->second->SetComponentSpacing((x - old_x) / advance,
-                                                       (y - old_y) / advance);
+                    t->SetComponentSpacing((x - old_x) / advance,
+                                           (y - old_y) / advance);
                 }
             }
         } else if (4 == sscanf(buffer, "board:%s %f %f %f\n", designator,
@@ -6,11 +6,14 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
+#include "machine-model.h"
 #include "rpt2pnp.h"
 
-class Tape;
+class Feeder;
 class Board;
+class PartTable;
 
 // (for now: simple) configuration for the setup needed to do pick-n-place.
 // TODO:
@@ -18,13 +21,31 @@ class Board;
 //  - multiple boards
 //  - board height.
 struct PnPConfig {
-    typedef std::map<std::string, Tape*> PartToTape;
+    // The same component can be on several tapes. Here and below, "tape"
+    // is any Feeder, also a tray.
+    typedef std::map<std::string, std::vector<Feeder*> > PartToTape;
     struct BoardConfig {
         Position origin;  // TODO: potentially rotation...
     };
-
     BoardConfig board;
+    MachineModel machine;
     PartToTape tape_for_component;
+
+    // Dense version of tape_for_component, indexed by the component key ID
+    // of the parts on the board; empty if there is no tape. Filled by
+    // ResolveComponentKeys().
+    std::vector<std::vector<Feeder*> > tapes_for_key;
+
+    // Height of the parts in mm, by footprint.
+    std::map<std::string, float> part_height;
+
+    // part_height by the component key ID of the parts on the board; -1 if
+    // not known. Filled by ResolveComponentKeys().
+    std::vector<float> height_for_key;
+
+    // The tape each part is to be taken from, indexed by part. Filled by
+    // PlanPickNPlace(); NULL for parts that have no tape.
+    std::vector<Feeder*> tape_for_part;
 };
 
 // Parse configuration and return newly allocated config object or NULL on
@@ -35,4 +56,10 @@ PnPConfig *ParsePnPConfiguration(const std::string& filename);
 // Simplified PNP config: one line at a time
 PnPConfig *ParseSimplePnPConfiguration(const Board &board,
                                        const std::string& filename);
+
+// Look up the tapes and heights for all component keys found in "parts"
+// once, so that later look-ups are a plain index into config->tapes_for_key
+// and config->height_for_key.
+void ResolveComponentKeys(const PartTable &parts, PnPConfig *config);
+
 #endif  // PNP_CONFIG_H
@@ -0,0 +1,433 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "pnp-planner.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+
+#include "board.h"
+#include "pnp-config.h"
+#include "spatial-index.h"
+#include "feeder.h"
+
+namespace {
+// Simulates taking components off the tapes of a configuration without
+// changing the originals: keeps its own count of components taken.
+class TapeSimulation {
+public:
+    explicit TapeSimulation(const PnPConfig &config)
+        : tapes_of_key_(config.tapes_for_key.size()) {
+        for (size_t key = 0; key < config.tapes_for_key.size(); ++key) {
+            for (Feeder *tape : config.tapes_for_key[key]) {
+                // Several components might share a tape.
+                auto inserted = index_.insert(std::make_pair(tape,
+                                                             tapes_.size()));
+                if (inserted.second) {
+                    tapes_.push_back(tape);
+                    taken_.push_back(tape->consumed());
+                    keys_of_tape_.push_back(std::vector<int>());
+                }
+                tapes_of_key_[key].push_back(inserted.first->second);
+                keys_of_tape_[inserted.first->second].push_back(key);
+            }
+        }
+    }
+
+    int tape_count() const { return tapes_.size(); }
+
+    // Tapes for a component key.
+    const std::vector<int> &TapesOf(int key) const {
+        static const std::vector<int> kNone;
+        return key < (int)tapes_of_key_.size() ? tapes_of_key_[key] : kNone;
+    }
+    // Component keys a tape provides.
+    const std::vector<int> &KeysOf(int tape) const {
+        return keys_of_tape_[tape];
+    }
+
+    // Index of the copy of "tape", -1 if not part of the configuration.
+    int IndexOf(const Feeder *tape) const {
+        auto found = index_.find(tape);
+        return found == index_.end() ? -1 : found->second;
+    }
+    Feeder *original(int tape) const { return tapes_[tape]; }
+
+    const Feeder &tape(int tape) const { return *tapes_[tape]; }
+    int count(int tape) const {
+        return tapes_[tape]->capacity() - taken_[tape];
+    }
+    // Index of the next component on the tape.
+    int next(int tape) const { return taken_[tape]; }
+
+    // Position of the next component on the tape; false if used up.
+    bool PickPos(int tape, Position *pos) {
+        if (count(tape) <= 0)
+            return false;
+        *pos = tapes_[tape]->PositionOf(taken_[tape]);
+        return true;
+    }
+
+    void Advance(int tape) { ++taken_[tape]; }
+
+private:
+    std::vector<Feeder*> tapes_;
+    std::vector<int> taken_;
+    std::map<const Feeder*, int> index_;
+    std::vector<std::vector<int> > tapes_of_key_;
+    std::vector<std::vector<int> > keys_of_tape_;
+};
+
+Position PlacePos(const PartTable &parts, const PnPConfig &config, int i) {
+    return Position(parts.x()[i] + config.board.origin.x,
+                    parts.y()[i] + config.board.origin.y);
+}
+
+// Nozzle angles as emitted by the G-code printer.
+float PickAngle(const Feeder &tape) { return tape.angle(); }
+float PlaceAngle(const PartTable &parts, const Feeder &tape, int i) {
+    return parts.angle(i) - tape.angle();
+}
+float PlaceAngle(const Part &part, const Feeder &tape) {
+    return part.angle - tape.angle();
+}
+}  // namespace
+
+bool PlanPickNPlace(const PartTable &parts, PnPConfig *config,
+                    std::vector<int> *order, bool low_parts_first) {
+    TapeSimulation tapes(*config);
+    config->tape_for_part.assign(parts.size(), NULL);
+
+    // Parts per component key, with an index over where they go on the
+    // board.
+    struct KeyParts {
+        std::vector<int> parts;
+        std::vector<float> x, y;
+        SpatialIndex index;
+    };
+    std::vector<KeyParts> per_key(parts.component_keys().size());
+    std::vector<int> no_tape;
+    for (int i : *order) {
+        const int key = parts.component_key_id(i);
+        if (tapes.TapesOf(key).empty()) {
+            no_tape.push_back(i);
+            continue;
+        }
+        const Position place = PlacePos(parts, *config, i);
+        per_key[key].parts.push_back(i);
+        per_key[key].x.push_back(place.x);
+        per_key[key].y.push_back(place.y);
+    }
+
+    // Fail early if there are just not enough components.
+    bool enough = true;
+    for (size_t key = 0; key < per_key.size(); ++key) {
+        int available = 0;
+        for (int t : tapes.TapesOf(key)) available += tapes.count(t);
+        const int needed = per_key[key].parts.size();
+        if (needed > available) {
+            fprintf(stderr, "Not enough components for '%s': %d needed, "
+                    "%d on tapes.\n", parts.component_keys().str(key),
+                    needed, available);
+            enough = false;
+        }
+    }
+    if (!enough)
+        return false;
+
+    // Next part for each tape: the one quickest to reach from its pick
+    // position, looking at the closest few. That only changes if the tape
+    // advances or if another tape with the same component takes that part.
+    static const int kCandidates = 8;
+    struct Candidate {
+        int key;           // -1 if none.
+        int id;            // In per_key[key].
+        Position pick;
+        float place_angle;
+        float pick_to_place;   // seconds.
+    };
+    const MachineModel &machine = config->machine;
+    // With low_parts_first, a lower part always wins; parts of unknown
+    // height go last.
+    auto height_of = [&](int key) {
+        if (!low_parts_first) return 0.0f;
+        const float height = config->height_for_key[key];
+        return height < 0 ? FLT_MAX : height;
+    };
+    std::vector<Candidate> next(tapes.tape_count());
+    std::vector<int> closest;
+    auto update_next = [&](int t) {
+        Candidate &c = next[t];
+        c.key = -1;
+        if (!tapes.PickPos(t, &c.pick))
+            return;
+        const float pick_angle = PickAngle(tapes.tape(t));
+        for (int key : tapes.KeysOf(t)) {
+            const KeyParts &kp = per_key[key];
+            kp.index.FindKNearest(c.pick, kCandidates, &closest);
+            for (int id : closest) {
+                const float place_angle
+                    = PlaceAngle(parts, tapes.tape(t), kp.parts[id]);
+                const float time = machine.MoveTime(
+                    c.pick, Position(kp.x[id], kp.y[id]),
+                    ShortestRotation(pick_angle, place_angle));
+                const float height = height_of(key);
+                const float best_height = c.key < 0 ? 0 : height_of(c.key);
+                if (c.key < 0 || height < best_height
+                    || (height == best_height && time < c.pick_to_place)) {
+                    c.key = key;
+                    c.id = id;
+                    c.place_angle = place_angle;
+                    c.pick_to_place = time;
+                }
+            }
+        }
+    };
+    for (KeyParts &kp : per_key) {
+        kp.index = SpatialIndex(kp.x.data(), kp.y.data(), kp.x.size());
+    }
+    for (int t = 0; t < tapes.tape_count(); ++t) {
+        update_next(t);
+    }
+
+    std::vector<int> result;
+    result.reserve(order->size());
+    Position current(0, 0);
+    float current_angle = 0;
+    for (;;) {
+        int best = -1;
+        float best_cost = 0, best_height = 0;
+        for (int t = 0; t < tapes.tape_count(); ++t) {
+            const Candidate &c = next[t];
+            if (c.key < 0) continue;
+            const float rotation = ShortestRotation(current_angle,
+                                                    PickAngle(tapes.tape(t)));
+            const float cost = machine.MoveTime(current, c.pick, rotation)
+                + c.pick_to_place;
+            const float height = height_of(c.key);
+            if (best < 0 || height < best_height
+                || (height == best_height && cost < best_cost)) {
+                best = t;
+                best_cost = cost;
+                best_height = height;
+            }
+        }
+        if (best < 0)
+            break;
+        const Candidate taken = next[best];
+        KeyParts &kp = per_key[taken.key];
+        const int part = kp.parts[taken.id];
+        result.push_back(part);
+        config->tape_for_part[part] = tapes.original(best);
+        current = Position(kp.x[taken.id], kp.y[taken.id]);
+        current_angle = taken.place_angle;
+        kp.index.Remove(taken.id);
+        tapes.Advance(best);
+        for (int t : tapes.TapesOf(taken.key)) {
+            if (t == best
+                || (next[t].key == taken.key && next[t].id == taken.id)) {
+                update_next(t);
+            }
+        }
+    }
+
+    // With tapes shared between components, the greedy choice above can
+    // use up a tape needed elsewhere.
+    for (size_t key = 0; key < per_key.size(); ++key) {
+        const int left = per_key[key].index.remaining();
+        if (left > 0) {
+            fprintf(stderr, "Ran out of components for '%s' (%d parts); "
+                    "tapes shared with other components are used up.\n",
+                    parts.component_keys().str(key), left);
+            enough = false;
+        }
+    }
+    if (!enough)
+        return false;
+
+    result.insert(result.end(), no_tape.begin(), no_tape.end());
+    order->swap(result);
+    return true;
+}
+
+PickNPlaceCost EstimatePickNPlace(const PartTable &parts,
+                                  const PnPConfig &config,
+                                  const std::vector<int> &order,
+                                  bool shortest_rotation) {
+    TapeSimulation tapes(config);
+    PickNPlaceCost cost;
+    Position current(0, 0);
+    float current_angle = 0;
+    Position pick;
+    // One leg of the way: x/y move plus nozzle rotation.
+    auto move = [&](const Position &to, float angle) {
+        const float rotation = shortest_rotation
+            ? ShortestRotation(current_angle, angle)
+            : angle - current_angle;
+        cost.travel += Distance(current, to);
+        cost.rotation += fabsf(rotation);
+        cost.seconds += config.machine.MoveTime(current, to, rotation);
+        current = to;
+        current_angle = angle;
+    };
+    for (int i : order) {
+        int t = -1;
+        if (!config.tape_for_part.empty()) {
+            t = tapes.IndexOf(config.tape_for_part[i]);
+        } else {
+            for (int candidate : tapes.TapesOf(parts.component_key_id(i))) {
+                t = candidate;
+                if (tapes.count(candidate) > 0) break;
+            }
+        }
+        if (t < 0 || !tapes.PickPos(t, &pick))
+            continue;
+        const Feeder &tape = tapes.tape(t);
+        if (shortest_rotation) {
+            move(pick, PickAngle(tape));
+            move(PlacePos(parts, config, i), PlaceAngle(parts, tape, i));
+        } else {
+            // Absolute angles, as the G-code used to have them.
+            move(pick, fmodf(PickAngle(tape), 360));
+            move(PlacePos(parts, config, i),
+                 fmodf(PlaceAngle(parts, tape, i) + 360, 360));
+        }
+        tapes.Advance(t);
+    }
+    return cost;
+}
+
+BatchScheduler::BatchScheduler(const PnPConfig &config)
+    : config_(config), angle_(config.machine.nozzles.size(), 0) {
+}
+
+float BatchScheduler::Schedule(const std::vector<Part> &batch,
+                               const std::vector<const Feeder*> &tapes,
+                               const std::vector<int> &next,
+                               std::vector<Step> *steps) {
+    const int n = batch.size();
+    const std::vector<Nozzle> &nozzles = config_.machine.nozzles;
+    assert(n <= (int)nozzles.size() && tapes.size() == batch.size()
+           && next.size() == batch.size());
+
+    // Several parts might come from the same tape; which position on the
+    // tape they get depends on the order they are picked in.
+    // tape_positions[slot][k]: k-th next component on the tape of "slot".
+    std::vector<std::vector<Position> > tape_positions(n);
+    for (int slot = 0; slot < n; ++slot) {
+        const int left = tapes[slot]->capacity() - next[slot];
+        for (int k = 0; k < n && k < left; ++k) {
+            tape_positions[slot].push_back(
+                tapes[slot]->PositionOf(next[slot] + k));
+        }
+    }
+    std::vector<Position> place(n);
+    std::vector<float> pick_angle(n), place_angle(n);
+    for (int slot = 0; slot < n; ++slot) {
+        place[slot] = Position(batch[slot].pos.x + config_.board.origin.x,
+                               batch[slot].pos.y + config_.board.origin.y);
+        pick_angle[slot] = PickAngle(*tapes[slot]);
+        place_angle[slot] = PlaceAngle(batch[slot], *tapes[slot]);
+    }
+
+    // Head position to have "slot" nozzle at "pos".
+    auto head_for = [&](int slot, const Position &pos) {
+        return Position(pos.x - nozzles[slot].offset.x,
+                        pos.y - nozzles[slot].offset.y);
+    };
+
+    // With up to four nozzles, trying all orders is cheap enough.
+    std::vector<int> pick_order(n), place_order(n);
+    for (int i = 0; i < n; ++i) pick_order[i] = i;
+    std::vector<int> best_pick, best_place;
+    float best_time = -1;
+    Position best_head;
+    do {
+        float time = 0;
+        Position head = head_;
+        for (int i = 0; i < n; ++i) {
+            const int slot = pick_order[i];
+            int taken_before = 0;   // From the same tape in this batch.
+            for (int j = 0; j < i; ++j) {
+                if (tapes[pick_order[j]] == tapes[slot]) ++taken_before;
+            }
+            const Position to = head_for(
+                slot, tape_positions[slot][taken_before]);
+            time += config_.machine.MoveTime(
+                head, to, ShortestRotation(angle_[slot], pick_angle[slot]));
+            head = to;
+        }
+        if (best_time >= 0 && time >= best_time)
+            continue;
+        const Position after_picks = head;
+        for (int i = 0; i < n; ++i) place_order[i] = i;
+        do {
+            float total = time;
+            head = after_picks;
+            for (int slot : place_order) {
+                const Position to = head_for(slot, place[slot]);
+                total += config_.machine.MoveTime(
+                    head, to, ShortestRotation(pick_angle[slot],
+                                               place_angle[slot]));
+                head = to;
+            }
+            if (best_time < 0 || total < best_time) {
+                best_time = total;
+                best_pick = pick_order;
+                best_place = place_order;
+                best_head = head;
+            }
+        } while (std::next_permutation(place_order.begin(),
+                                       place_order.end()));
+    } while (std::next_permutation(pick_order.begin(), pick_order.end()));
+
+    for (int slot : best_pick) steps->push_back({ true, slot });
+    for (int slot : best_place) steps->push_back({ false, slot });
+    head_ = best_head;
+    for (int slot = 0; slot < n; ++slot) angle_[slot] = place_angle[slot];
+    const MachineModel &machine = config_.machine;
+    return std::max(best_time, 0.0f)
+        + n * (machine.PickTime() + machine.PlaceTime());
+}
+
+float EstimateCycleTime(const PartTable &parts, const PnPConfig &config,
+                        const std::vector<int> &order, int nozzles) {
+    TapeSimulation tapes(config);
+    BatchScheduler scheduler(config);
+    std::vector<Part> batch;
+    std::vector<const Feeder*> batch_tapes;
+    std::vector<int> batch_next;
+    std::vector<int> batch_tape_index;
+    std::vector<BatchScheduler::Step> steps;
+    double seconds = 0;
+    auto flush = [&]() {
+        if (batch.empty()) return;
+        seconds += scheduler.Schedule(batch, batch_tapes, batch_next, &steps);
+        for (int t : batch_tape_index) tapes.Advance(t);
+        batch.clear();
+        batch_tapes.clear();
+        batch_next.clear();
+        batch_tape_index.clear();
+    };
+    for (int i : order) {
+        if (config.tape_for_part.empty())
+            break;
+        const int t = tapes.IndexOf(config.tape_for_part[i]);
+        if (t < 0)
+            continue;
+        batch.push_back(parts.part(i));
+        batch_tapes.push_back(&tapes.tape(t));
+        batch_next.push_back(tapes.next(t));
+        batch_tape_index.push_back(t);
+        if ((int)batch.size() == nozzles)
+            flush();
+    }
+    flush();
+    return seconds;
+}
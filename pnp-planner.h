@@ -0,0 +1,87 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Ordering parts for pick'n place: the cost of placing a part is not the
+ * distance on the board, but the travel from the previous placement to the
+ * tape and from there to the part's place on the board.
+ */
+#ifndef PNP_PLANNER_H
+#define PNP_PLANNER_H
+
+#include <vector>
+
+#include "rpt2pnp.h"
+
+class PartTable;
+class Feeder;
+struct Part;
+struct PnPConfig;
+
+// Arrange "order", which contains indices into "parts", so that the time
+// for moving and rotating the nozzle for picking and placing is short,
+// with speeds from config->machine. Also decides which tape each part
+// is taken from if a component is on several tapes. The choice is stored
+// in config->tape_for_part. Takes into account that tapes advance with each
+// component taken and only have so many; the tapes themselves are not
+// modified. Parts without a tape go to the end in their original order.
+// With "low_parts_first", parts are placed by height from
+// config->height_for_key, lowest first, so the nozzle can travel low for as
+// long as possible; parts of unknown height come last.
+// Returns false, with a message on stderr, if there are not enough
+// components on the tapes for all parts.
+bool PlanPickNPlace(const PartTable &parts, PnPConfig *config,
+                    std::vector<int> *order, bool low_parts_first = false);
+
+struct PickNPlaceCost {
+    PickNPlaceCost() : travel(0), rotation(0), seconds(0) {}
+    double travel;     // x/y nozzle travel in mm.
+    double rotation;   // Nozzle rotation in degrees.
+    double seconds;    // Estimated time of these moves, see MachineModel.
+};
+
+// Estimate the cost of picking and placing the parts in "order", starting
+// at 0/0 with the nozzle at 0 degrees. Parts are taken from
+// config.tape_for_part if planned, otherwise from the first tape with
+// components left; parts that can't be placed are skipped.
+// With "shortest_rotation", the nozzle turns the short way to each angle,
+// otherwise to the absolute angle in 0..360.
+PickNPlaceCost EstimatePickNPlace(const PartTable &parts,
+                                  const PnPConfig &config,
+                                  const std::vector<int> &order,
+                                  bool shortest_rotation);
+
+// Picks and places parts in batches, one part per nozzle: first all the
+// picks, then all the places, each in the order that takes the least time.
+// Keeps track of where the head and the nozzle rotations are.
+class BatchScheduler {
+public:
+    struct Step {
+        bool pick;   // Otherwise place.
+        int slot;    // Index of the part in the batch, which is the nozzle.
+    };
+
+    explicit BatchScheduler(const PnPConfig &config);
+
+    // Schedule a batch of at most as many parts as there are nozzles,
+    // taken from "tapes" (one per part), where the next component to take
+    // has index "next" (one per part; the state before picking). The
+    // tapes are not modified. Appends the steps; returns estimated seconds,
+    // including going up and down at each tape and place.
+    float Schedule(const std::vector<Part> &batch,
+                   const std::vector<const Feeder*> &tapes,
+                   const std::vector<int> &next,
+                   std::vector<Step> *steps);
+
+private:
+    const PnPConfig &config_;
+    Position head_;                 // Where the first nozzle is.
+    std::vector<float> angle_;      // Per nozzle.
+};
+
+// Estimated seconds for picking and placing the parts in "order" with
+// tapes assigned by PlanPickNPlace(), using the first "nozzles" nozzles.
+// Includes all moves and dwell times.
+float EstimateCycleTime(const PartTable &parts, const PnPConfig &config,
+                        const std::vector<int> &order, int nozzles);
+
+#endif  // PNP_PLANNER_H
@@ -4,17 +4,18 @@
 
 #include "postscript-printer.h"
 
-PostScriptPrinter::PostScriptPrinter(const PnPConfig *pnp_config) {
+PostScriptPrinter::PostScriptPrinter(const PnPConfig *pnp_config, FILE *out)
+    : Printer(out) {
     // TODO: read config.
 }
 
 void PostScriptPrinter::Init(const Dimension& board_dim) {
     corners_.SetCorners(0, 0, board_dim.w, board_dim.h);
     const float mm_to_point = 1 / 25.4 * 72.0;
-    printf("%%!PS-Adobe-3.0\n%%%%BoundingBox: %.0f %.0f %.0f %.0f\n\n",
-           -2 * mm_to_point, -2 * mm_to_point,
-           board_dim.w * mm_to_point, board_dim.h * mm_to_point);
-    printf("%s", R"(
+    out_.Printf("%%!PS-Adobe-3.0\n%%%%BoundingBox: %.0f %.0f %.0f %.0f\n\n",
+                -2 * mm_to_point, -2 * mm_to_point,
+                board_dim.w * mm_to_point, board_dim.h * mm_to_point);
+    out_.Append(R"(
 % <dx> <dy> <x0> <y0>
 /rect {
   moveto
@@ -40,33 +41,33 @@ void PostScriptPrinter::Init(const Dimension& board_dim) {
     grestore
 } def
 )");
-    printf("72.0 25.4 div dup scale  %% Switch to mm\n");
-    printf("0.1 setlinewidth\n");
-    printf("/Helvetica findfont 1 scalefont setfont\n");
-    printf("%.1f %.1f moveto\n", 0.0, 0.0);
+    out_.Append("72.0 25.4 div dup scale  % Switch to mm\n");
+    out_.Append("0.1 setlinewidth\n");
+    out_.Append("/Helvetica findfont 1 scalefont setfont\n");
+    out_.Printf("%.1f %.1f moveto\n", 0.0, 0.0);
 }
 
 void PostScriptPrinter::PrintPart(const Part &part) {
     corners_.Update(part.pos, part);
-    printf("%.3f %.3f   %.3f %.3f (%s) (%s) %.3f %.3f %.3f pp\n",
-           part.bounding_box.p1.x - part.bounding_box.p0.x,
-           part.bounding_box.p1.y - part.bounding_box.p0.y,
-           part.bounding_box.p0.x, part.bounding_box.p0.y,
-           "", //(part.footprint + "@" + part.value).c_str(),
-           part.component_name.c_str(),
-           part.angle, part.pos.x, part.pos.y);
+    out_.Printf("%.3f %.3f   %.3f %.3f (%s) (%s) %.3f %.3f %.3f pp\n",
+                part.bounding_box.p1.x - part.bounding_box.p0.x,
+                part.bounding_box.p1.y - part.bounding_box.p0.y,
+                part.bounding_box.p0.x, part.bounding_box.p0.y,
+                "", //(part.footprint + "@" + part.value).c_str(),
+                part.component_name,
+                part.angle, part.pos.x, part.pos.y);
 }
 
 void PostScriptPrinter::Finish() {
 #if 0
     // Doesn't work that well currently.
-    printf("0 0 1 setrgbcolor\n");
+    out_.Append("0 0 1 setrgbcolor\n");
     for (int i = 0; i < 4; ++i) {
         //const ::Part &part = corners_.get_part(i);
         const Position &pos = corners_.get_closest(i);
-        printf("%.1f 2 add %.1f moveto %.1f %.1f 2 0 360 arc stroke\n",
-               pos.x, pos.y, pos.x, pos.y);
+        out_.Printf("%.1f 2 add %.1f moveto %.1f %.1f 2 0 360 arc stroke\n",
+                    pos.x, pos.y, pos.x, pos.y);
     }
 #endif
-    printf("showpage\n");
+    out_.Append("showpage\n");
 }
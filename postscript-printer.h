@@ -11,7 +11,7 @@ struct PnPConfig;
 class PostScriptPrinter : public Printer {
 public:
     // If we get a pnp configuration (i.e. non-NULL), we print the process.
-    PostScriptPrinter(const PnPConfig *config);
+    PostScriptPrinter(const PnPConfig *config, FILE *out = stdout);
 
     ~PostScriptPrinter() override {}
     void Init(const Dimension& board_dim) override;
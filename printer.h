@@ -8,15 +8,27 @@
 #include "rpt2pnp.h"
 #include "board.h"
 #include "corner-part-collector.h"
+#include "gcode-template.h"
+#include "height-map.h"
+#include "output-buffer.h"
+#include "pnp-planner.h"
 
 struct PnPConfig;
 
 class Printer {
 public:
+    // Output goes to "out".
+    explicit Printer(FILE *out = stdout) : out_(out) {}
     virtual ~Printer() {}
     virtual void Init(const Dimension& dimension) = 0;
     virtual void PrintPart(const Part &part) = 0;
     virtual void Finish() = 0;
+
+    // Where implementations write their output to.
+    OutputBuffer *output() { return &out_; }
+
+protected:
+    OutputBuffer out_;
 };
 
 //-- Some implementations of a printer. For lazyness reasons all in this header
@@ -51,16 +63,114 @@ private:
     const float area_ms_;
 };
 
+// Parts are collected in batches of one per nozzle, then picked and placed.
 class GCodePickNPlace : public Printer {
 public:
-    GCodePickNPlace(const PnPConfig *pnp_config);
+    // With more than one thread, the G-code text is formatted on "threads"
+    // threads; the output is the same.
+    GCodePickNPlace(const PnPConfig *pnp_config, int threads = 1,
+                    FILE *out = stdout);
+
+    // Use the templates in "filename" instead of the built-in ones, see
+    // GCodeTemplates::Load(). Returns false if they can't be loaded, if
+    // they can't select a nozzle and there are several, or if they don't
+    // approach slowly and the config has an approach-speed.
+    bool LoadTemplates(const char *filename);
 
     void Init(const Dimension& dim) override;
     void PrintPart(const Part& part) override;
     void Finish() override;
 
 private:
+    // One step of the G-code with all numbers resolved. Determining these
+    // has to happen in order, as tapes advance and nozzles rotate; after
+    // that, each can be formatted on its own.
+    struct Move {
+        enum Kind { SELECT_NOZZLE, PICK, PLACE } kind;
+        int nozzle;
+        const char *name;
+        const char *key;
+        float x, y;
+        float z_up, z_down;
+        float z_near;      // Where the slow approach starts.
+        float z_retract;   // Going back up to; where the next move travels.
+        float z_lift;      // Straight up at least this far before the
+                           // travel may rise the rest of the way.
+        float angle;   // Of the nozzle, in degrees.
+        float e;
+    };
+
+    void PrintBatch();
+
+    // Select nozzle, if there is more than one.
+    void SelectNozzle(int nozzle);
+
+    // Rotate nozzle the short way to "angle"; sets the angle and E-axis
+    // position of "move".
+    void RotateTo(int nozzle, float angle, Move *move);
+
+    // Lowest height for the head to travel from where it is to "to", with
+    // "z_down" at the end: above everything in the way of each nozzle and
+    // what it carries. Never higher than hovering above "pick_z".
+    float TravelZ(const Position &to, float z_down, float pick_z) const;
+
+    // Lowest height to go straight up to from "z_from" at "from", so that
+    // rising evenly from there to "z_to" on the way to "to" stays as far
+    // above everything as TravelZ() does; without a hover margin, by the
+    // clearance above the highest pick-up. "z_to" if that is not known.
+    float LiftZ(const Position &from, float z_from,
+                const Position &to, float z_to) const;
+
+    // Picks and places go back up to where the next one travels and get
+    // their z_lift; until that is known, they and nozzle selections wait
+    // in lookahead_.
+    void AddMove(const Move &move);
+    void QueueMove(const Move &move);
+    void FormatMove(const Move &move, OutputBuffer *out) const;
+
+    // Fields from the Machine: section, the same for all templates.
+    GCodeTemplate::Values MachineValues() const;
+
+    // Format the pending moves on all threads and write them in order.
+    void FormatPendingMoves();
+
     const PnPConfig* config_;
+    const int threads_;
+    GCodeTemplates templates_;
+    const GCodeTemplate::Values machine_values_;
+    BatchScheduler scheduler_;
+    std::vector<Part> batch_;
+    std::vector<Feeder*> batch_tapes_;
+    std::vector<float> nozzle_angle_;   // Degrees; not limited to 0..360.
+    int current_nozzle_;
+    std::vector<Move> lookahead_;
+    std::vector<Move> pending_moves_;
+
+    // For travel height with hover_margin: what is on the bed, where the
+    // head is, and per nozzle what hangs below it: height (-1 if unknown)
+    // and how far it reaches sideways.
+    HeightMap obstacles_;
+    Dimension board_size_;
+    bool board_added_;
+    Position head_;
+    std::vector<float> carried_height_;
+    std::vector<float> carried_reach_;
+    float highest_pick_;   // Of all feeders.
+};
+
+// One line per part in the order it is placed: where it goes and, with a
+// config, how high it is.
+class ReportPrinter : public Printer {
+public:
+    ReportPrinter(const PnPConfig *pnp_config, FILE *out = stdout);
+
+    void Init(const Dimension& dim) override;
+    void PrintPart(const Part& part) override;
+    void Finish() override;
+
+private:
+    const PnPConfig *const config_;
+    int count_;
 };
 
 #endif  // PRINTER_H
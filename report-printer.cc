@@ -0,0 +1,33 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "printer.h"
+
+#include "pnp-config.h"
+
+ReportPrinter::ReportPrinter(const PnPConfig *config, FILE *out)
+    : Printer(out), config_(config), count_(0) {}
+
+void ReportPrinter::Init(const Dimension& dim) {
+    out_.Printf("# Board %.1f x %.1f mm. Parts in the order they are placed.\n"
+                "# n\tname\tfootprint@value\tx\ty\tangle\theight\n",
+                dim.w, dim.h);
+}
+
+void ReportPrinter::PrintPart(const Part& part) {
+    out_.Printf("%d\t%s\t%s\t%.3f\t%.3f\t%.1f\t", ++count_,
+                part.component_name, part.component_key,
+                part.pos.x, part.pos.y, part.angle);
+    const float height = config_ != NULL
+        ? config_->height_for_key[part.component_key_id] : -1;
+    if (height >= 0) {
+        out_.Printf("%.2f\n", height);
+    } else {
+        out_.Append("-\n");   // Not known.
+    }
+}
+
+void ReportPrinter::Finish() {
+    out_.Printf("# %d parts\n", count_);
+}
@@ -2,98 +2,295 @@
  * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
  */
 
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
 #include <string>
 #include <iostream>
+#include <iterator>
+#include <thread>
 
+#include "number-parser.h"
 #include "rpt-parser.h"
 
+namespace {
+enum Keyword {
+    KW_NONE,
+    KW_UNIT,
+    KW_UPPER_LEFT_CORNER,
+    KW_LOWER_RIGHT_CORNER,
+    KW_END_BOARD,
+    KW_MODULE,
+    KW_END_MODULE,
+    KW_PAD,
+    KW_END_PAD,
+    KW_POSITION,
+    KW_SIZE,
+    KW_DRILL,
+    KW_ORIENTATION,
+    KW_VALUE,
+    KW_FOOTPRINT,
+};
+
+// Most tokens in an RPT file are numbers or keywords we don't care about, so
+// first dispatch on the length, then only compare the few candidates.
+Keyword LookupKeyword(const char *t, size_t len) {
+#define KEYWORD_IF(s, kw) if (memcmp(t, s, sizeof(s) - 1) == 0) return kw
+    switch (len) {
+    case 4:
+        KEYWORD_IF("unit", KW_UNIT);
+        KEYWORD_IF("size", KW_SIZE);
+        KEYWORD_IF("$PAD", KW_PAD);
+        break;
+    case 5:
+        KEYWORD_IF("drill", KW_DRILL);
+        KEYWORD_IF("value", KW_VALUE);
+        break;
+    case 7:
+        KEYWORD_IF("$MODULE", KW_MODULE);
+        KEYWORD_IF("$EndPAD", KW_END_PAD);
+        break;
+    case 8:
+        KEYWORD_IF("position", KW_POSITION);
+        break;
+    case 9:
+        KEYWORD_IF("footprint", KW_FOOTPRINT);
+        KEYWORD_IF("$EndBOARD", KW_END_BOARD);
+        break;
+    case 10:
+        KEYWORD_IF("$EndMODULE", KW_END_MODULE);
+        break;
+    case 11:
+        KEYWORD_IF("orientation", KW_ORIENTATION);
+        break;
+    case 17:
+        KEYWORD_IF("upper_left_corner", KW_UPPER_LEFT_CORNER);
+        break;
+    case 18:
+        KEYWORD_IF("lower_right_corner", KW_LOWER_RIGHT_CORNER);
+        break;
+    }
+#undef KEYWORD_IF
+    return KW_NONE;
+}
+
+// Whitespace separated tokens straight out of the buffer; no copying.
+class Tokenizer {
+public:
+    Tokenizer(const char *buffer, size_t size)
+        : pos_(buffer), end_(buffer + size) {}
+
+    // Get next token. Returns 'false' if there is none.
+    bool Next(const char **token, size_t *len) {
+        while (pos_ < end_ && IsSpace(*pos_)) ++pos_;
+        if (pos_ >= end_)
+            return false;
+        const char *start = pos_;
+        while (pos_ < end_ && !IsSpace(*pos_)) ++pos_;
+        *token = start;
+        *len = pos_ - start;
+        return true;
+    }
+
+    // Read a number. Non-numbers and missing tokens read as 0.
+    float NextFloat() {
+        const char *token;
+        size_t len;
+        float result;
+        if (!Next(&token, &len) || !ParseFloat(token, len, &result))
+            return 0;
+        return result;
+    }
+
+    // Read a token, stripped of its surrounding quotes.
+    void NextUnquoted(std::string *out) {
+        const char *token;
+        size_t len;
+        if (Next(&token, &len) && len >= 2)
+            out->assign(token + 1, len - 2);
+        else
+            out->clear();
+    }
+
+private:
+    static bool IsSpace(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t'
+            || c == '\v' || c == '\f';
+    }
+
+    const char *pos_;
+    const char *const end_;
+};
+
 // Very crude parser. No error handling. Quick hack.
-bool RptParse(std::istream *input, ParseEventReceiver *event) {
-    float unit_to_mm = 1;
+// Keeps the coordinate system from the $BOARD section, so that it can
+// continue parsing modules in a separate chunk of the file.
+class RptParser {
+public:
+    RptParser() : unit_to_mm_(1), x1_(0), y1_(0), x2_(0), y2_(0) {}
+    RptParser(const RptParser &other) = default;
+
+    void Parse(const char *buffer, size_t size, ParseEventReceiver *event);
+
+private:
+    float unit_to_mm_;
 
     // Board dimensions.
-    float x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    float x1_, y1_, x2_, y2_;
+};
 
+void RptParser::Parse(const char *buffer, size_t size,
+                      ParseEventReceiver *event) {
     bool in_pad = false;
 
-    while (!input->eof()) {
-        std::string token;
-        (*input) >> token;
+    // Re-used for all string values, so that we don't allocate per token.
+    std::string value;
 
-        if (token == "unit") {
-            std::string value;
-            (*input) >> value;
-            if (value == "INCH")
-                unit_to_mm = 25.4;
-        }
-        else if (token == "upper_left_corner") {  // in $BOARD
-            (*input) >> x1 >> y1;
-        }
-        else if (token == "lower_right_corner") {  // in $BOARD
-            (*input) >> x2 >> y2;
-        }
-        else if (token == "$EndBOARD") {
+    Tokenizer input(buffer, size);
+    const char *token;
+    size_t len;
+    while (input.Next(&token, &len)) {
+        switch (LookupKeyword(token, len)) {
+        case KW_NONE:
+            break;
+        case KW_UNIT:
+            if (input.Next(&token, &len) && len == 4
+                && memcmp(token, "INCH", 4) == 0) {
+                unit_to_mm_ = 25.4;
+            }
+            break;
+        case KW_UPPER_LEFT_CORNER:  // in $BOARD
+            x1_ = input.NextFloat();
+            y1_ = input.NextFloat();
+            break;
+        case KW_LOWER_RIGHT_CORNER:  // in $BOARD
+            x2_ = input.NextFloat();
+            y2_ = input.NextFloat();
+            break;
+        case KW_END_BOARD:
             // Now we have everything together to announcd the board
             // dimensions.
-            event->StartBoard((x2 - x1) * unit_to_mm,
-                              (y2 - y1) * unit_to_mm);
-        }
-        else if (token == "$MODULE") {
-            std::string value;
-            (*input) >> value;
-            value = value.substr(1, value.length() - 2);
+            event->StartBoard((x2_ - x1_) * unit_to_mm_,
+                              (y2_ - y1_) * unit_to_mm_);
+            break;
+        case KW_MODULE:
+            input.NextUnquoted(&value);
             event->StartComponent(value);
             in_pad = false;
-        }
-        else if (token == "$EndMODULE")
+            break;
+        case KW_END_MODULE:
             event->EndComponent();
-        else if (token == "$PAD") {
+            break;
+        case KW_PAD:
             in_pad = true;
-            std::string value;
-            (*input) >> value;
+            if (input.Next(&token, &len))
+                value.assign(token, len);
+            else
+                value.clear();
             event->StartPad(value);
-        }
-        else if (token == "$EndPAD")
+            break;
+        case KW_END_PAD:
             event->EndPad();
-        else if (token == "position") {
-            float x, y;
-            (*input) >> x >> y;
+            break;
+        case KW_POSITION: {
+            float x = input.NextFloat();
+            float y = input.NextFloat();
             // Pad positions are relative to module positions
             if (in_pad) {
                 y = -y;
             } else {
-                x -= x1;
-                y = y2 - y; // somehow we're mirrored.
+                x -= x1_;
+                y = y2_ - y; // somehow we're mirrored.
             }
-            event->Position(x * unit_to_mm, y * unit_to_mm);
+            event->Position(x * unit_to_mm_, y * unit_to_mm_);
+            break;
         }
-        else if (token == "size") {
-            float w, h;
-            (*input) >> w >> h;
-            event->Size(w * unit_to_mm, h * unit_to_mm);
+        case KW_SIZE: {
+            const float w = input.NextFloat();
+            const float h = input.NextFloat();
+            event->Size(w * unit_to_mm_, h * unit_to_mm_);
+            break;
         }
-        else if (token == "drill") {
-            float dia;
-            (*input) >> dia;
-            event->Drill(dia * unit_to_mm);
-        }
-        else if (token == "orientation") {
-            float angle;
-            (*input) >> angle;
-            event->Orientation(angle);
-        }
-        else if (token == "value") {
-            std::string value;
-            (*input) >> value;
-            value = value.substr(1, value.length() - 2);
+        case KW_DRILL:
+            event->Drill(input.NextFloat() * unit_to_mm_);
+            break;
+        case KW_ORIENTATION:
+            event->Orientation(input.NextFloat());
+            break;
+        case KW_VALUE:
+            input.NextUnquoted(&value);
             event->Value(value);
-        }
-        else if (token == "footprint") {
-            std::string value;
-            (*input) >> value;
-            value = value.substr(1, value.length() - 2);
+            break;
+        case KW_FOOTPRINT:
+            input.NextUnquoted(&value);
             event->Footprint(value);
+            break;
         }
     }
+}
+
+// Returns the start of the first line beginning with $MODULE at or after
+// "from", or "end" if there is none.
+const char *FindModuleStart(const char *buffer, const char *from,
+                            const char *end) {
+    static const char kModuleLine[] = "\n$MODULE";
+    if (from == buffer && end - from >= 7 && memcmp(from, "$MODULE", 7) == 0)
+        return from;
+    if (from > buffer) --from;  // In case we're just at the start of a line.
+    const void *found = memmem(from, end - from,
+                               kModuleLine, sizeof(kModuleLine) - 1);
+    return found ? (const char*) found + 1 : end;
+}
+}  // namespace
+
+bool RptParse(const char *buffer, size_t size, ParseEventReceiver *event) {
+    RptParser parser;
+    parser.Parse(buffer, size, event);
+    return true;
+}
+
+bool RptParse(std::istream *input, ParseEventReceiver *event) {
+    const std::string content((std::istreambuf_iterator<char>(*input)),
+                              std::istreambuf_iterator<char>());
+    return RptParse(content.data(), content.size(), event);
+}
+
+bool RptParseParallel(const char *buffer, size_t size, int num_threads,
+                      ParseEventReceiver *header_event,
+                      const std::vector<ParseEventReceiver*> &chunk_events) {
+    const char *const end = buffer + size;
+    const char *const modules = FindModuleStart(buffer, buffer, end);
+
+    // The header establishes the coordinate system all modules need.
+    RptParser header_parser;
+    header_parser.Parse(buffer, modules - buffer, header_event);
+
+    // Roughly equal sized chunks, adjusted to start at a module.
+    const int chunk_count = chunk_events.size();
+    std::vector<const char*> boundary(chunk_count + 1);
+    boundary[0] = modules;
+    for (int i = 1; i < chunk_count; ++i) {
+        const char *split = modules + (end - modules) * i / chunk_count;
+        boundary[i] = FindModuleStart(buffer, std::max(split, boundary[i-1]),
+                                      end);
+    }
+    boundary[chunk_count] = end;
+
+    std::atomic<int> next_chunk(0);
+    auto parse_chunks = [&]() {
+        int c;
+        while ((c = next_chunk.fetch_add(1)) < chunk_count) {
+            RptParser parser(header_parser);
+            parser.Parse(boundary[c], boundary[c+1] - boundary[c],
+                         chunk_events[c]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < num_threads && t < chunk_count; ++t)
+        workers.push_back(std::thread(parse_chunks));
+    parse_chunks();
+    for (std::thread &t : workers)
+        t.join();
     return true;
 }
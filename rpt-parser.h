@@ -40,3 +40,18 @@ public:
 // parse RPT file, get raw parse events.
 bool RptParse(std::istream *input, ParseEventReceiver *event);
 
+// Same, but parse RPT content that is already in memory, e.g. a mapped file.
+// The buffer does not need to be nul-terminated. This is the fast path: tokens
+// are not copied, only string values passed to the events are.
+bool RptParse(const char *buffer, size_t size, ParseEventReceiver *event);
+
+// Parse in memory RPT content on up to "num_threads" threads.
+// Everything before the first $MODULE, i.e. the $BOARD section, is parsed
+// first with events going to "header_event". The modules are then split into
+// chunk_events.size() chunks at $MODULE lines. Events of the i-th chunk go to
+// chunk_events[i], so processing the receivers in sequence keeps file order.
+// Each receiver only ever gets called from one thread.
+bool RptParseParallel(const char *buffer, size_t size, int num_threads,
+                      ParseEventReceiver *header_event,
+                      const std::vector<ParseEventReceiver*> &chunk_events);
+
@@ -8,7 +8,7 @@
 #include <vector>
 #include <string>
 
-struct Part;
+class PartTable;
 
 struct Position {
     Position(float xx, float yy) : x(xx), y(yy) {}
@@ -31,8 +31,33 @@ struct Box {
 
 float Distance(const Position& a, const Position& b);
 
+// Rotation in degrees to get from angle "from" to angle "to" the short way
+// round; in the range [-180, 180].
+float ShortestRotation(float from, float to);
+
 // Find acceptable route for pad visiting. Ideally solves TSP, but
 // heuristics are good as well. (optimizer.cc)
-void OptimizeParts(std::vector<const Part*> *parts);
+// "order" contains indices into "parts" and is re-arranged in place; the
+// first element stays the start of the route.
+void OptimizeParts(const PartTable &parts, std::vector<int> *order);
+
+struct RouteOptions {
+    RouteOptions() : budget_ms(0), threads(1), seed(1), max_rounds(-1) {}
+    int budget_ms;    // Wall-clock time allowed.
+    int threads;      // Threads for perturbation rounds.
+    unsigned seed;    // Random seed for perturbations.
+    int max_rounds;   // Stop after this many rounds; -1: until budget is up.
+};
+
+// Improve an existing route with 2-opt and Or-opt moves, keeping the start,
+// followed by rounds of parallel randomized perturbation and local search.
+// Stops when "max_rounds" are done or the time budget is used up; the route
+// is always the best found so far. The result only depends on seed, thread
+// count and number of rounds, which is returned. (optimizer.cc)
+int ImproveRoute(const PartTable &parts, const RouteOptions &options,
+                 std::vector<int> *order);
+
+// Length of the route visiting "order" parts in sequence.
+float RouteLength(const PartTable &parts, const std::vector<int> &order);
 
 #endif // RPT2PNP_H
@@ -0,0 +1,195 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "spatial-index.h"
+
+#include <algorithm>
+
+struct SpatialIndex::Candidate {
+    float dist;
+    int id;
+    bool operator<(const Candidate &other) const {   // for max-heap.
+        return dist < other.dist || (dist == other.dist && id < other.id);
+    }
+};
+
+static inline float SquaredDist(float ax, float ay, float bx, float by) {
+    const float dx = ax - bx;
+    const float dy = ay - by;
+    return dx * dx + dy * dy;
+}
+
+SpatialIndex::SpatialIndex() : remaining_(0) {}
+
+struct SpatialIndex::Point {
+    float x, y;
+    int id;
+};
+
+SpatialIndex::SpatialIndex(const float *x, const float *y, int count)
+    : x_(count), y_(count), id_(count), split_y_(count),
+      removed_(count), alive_(count), node_of_(count), remaining_(count) {
+    std::vector<Point> points(count);
+    for (int i = 0; i < count; ++i) {
+        points[i].x = x[i];
+        points[i].y = y[i];
+        points[i].id = i;
+    }
+    Build(&points, 0, count);
+    for (int node = 0; node < count; ++node) {
+        x_[node] = points[node].x;
+        y_[node] = points[node].y;
+        id_[node] = points[node].id;
+        node_of_[points[node].id] = node;
+    }
+}
+
+// Re-arranges the points in [lo, hi) so that the median along the larger
+// extent ends up in the middle, then recurses into both halves.
+void SpatialIndex::Build(std::vector<Point> *points, int lo, int hi) {
+    if (hi <= lo)
+        return;
+    alive_[(lo + hi) / 2] = hi - lo;
+    if (hi - lo == 1)
+        return;
+    const Point *p = points->data();
+    float min_x = p[lo].x, max_x = p[lo].x, min_y = p[lo].y, max_y = p[lo].y;
+    for (int i = lo + 1; i < hi; ++i) {
+        min_x = std::min(min_x, p[i].x); max_x = std::max(max_x, p[i].x);
+        min_y = std::min(min_y, p[i].y); max_y = std::max(max_y, p[i].y);
+    }
+    const bool split_y = (max_y - min_y) > (max_x - min_x);
+    const int mid = (lo + hi) / 2;
+    std::nth_element(points->begin() + lo, points->begin() + mid,
+                     points->begin() + hi,
+                     [split_y](const Point &a, const Point &b) {
+                         return split_y ? a.y < b.y : a.x < b.x;
+                     });
+    split_y_[mid] = split_y;
+    Build(points, lo, mid);
+    Build(points, mid + 1, hi);
+}
+
+void SpatialIndex::Remove(int id) {
+    const int node = node_of_[id];
+    if (removed_[node])
+        return;
+    removed_[node] = true;
+    --remaining_;
+    // Walk down from the root to the node, updating the counts on the way.
+    int lo = 0, hi = size();
+    for (;;) {
+        const int mid = (lo + hi) / 2;
+        --alive_[mid];
+        if (node == mid)
+            break;
+        if (node < mid)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+}
+
+int SpatialIndex::FindNearest(const Position &pos) const {
+    int best_node = -1;
+    float best_dist = 0;
+    SearchNearest(0, size(), pos.x, pos.y, &best_node, &best_dist);
+    return best_node < 0 ? -1 : id_[best_node];
+}
+
+void SpatialIndex::SearchNearest(int lo, int hi, float qx, float qy,
+                                 int *best_node, float *best_dist) const {
+    if (lo >= hi)
+        return;
+    const int mid = (lo + hi) / 2;
+    if (alive_[mid] == 0)
+        return;
+    if (!removed_[mid]) {
+        const float dist = SquaredDist(qx, qy, x_[mid], y_[mid]);
+        if (*best_node < 0 || dist < *best_dist
+            || (dist == *best_dist && id_[mid] < id_[*best_node])) {
+            *best_node = mid;
+            *best_dist = dist;
+        }
+    }
+    const float diff = split_y_[mid] ? qy - y_[mid] : qx - x_[mid];
+    if (diff < 0) {
+        SearchNearest(lo, mid, qx, qy, best_node, best_dist);
+        if (*best_node < 0 || diff * diff <= *best_dist)
+            SearchNearest(mid + 1, hi, qx, qy, best_node, best_dist);
+    } else {
+        SearchNearest(mid + 1, hi, qx, qy, best_node, best_dist);
+        if (*best_node < 0 || diff * diff <= *best_dist)
+            SearchNearest(lo, mid, qx, qy, best_node, best_dist);
+    }
+}
+
+void SpatialIndex::FindKNearest(const Position &pos, int k,
+                                std::vector<int> *result) const {
+    result->clear();
+    if (k <= 0)
+        return;
+    std::vector<Candidate> heap;
+    heap.reserve(k + 1);
+    SearchKNearest(0, size(), pos.x, pos.y, k, &heap);
+    std::sort_heap(heap.begin(), heap.end());
+    for (const Candidate &c : heap) {
+        result->push_back(c.id);
+    }
+}
+
+void SpatialIndex::SearchKNearest(int lo, int hi, float qx, float qy, int k,
+                                  std::vector<Candidate> *heap) const {
+    if (lo >= hi)
+        return;
+    const int mid = (lo + hi) / 2;
+    if (alive_[mid] == 0)
+        return;
+    if (!removed_[mid]) {
+        const Candidate c = { SquaredDist(qx, qy, x_[mid], y_[mid]),
+                              id_[mid] };
+        if ((int) heap->size() < k) {
+            heap->push_back(c);
+            std::push_heap(heap->begin(), heap->end());
+        } else if (c < heap->front()) {
+            std::pop_heap(heap->begin(), heap->end());
+            heap->back() = c;
+            std::push_heap(heap->begin(), heap->end());
+        }
+    }
+    const float diff = split_y_[mid] ? qy - y_[mid] : qx - x_[mid];
+    const int near_lo = diff < 0 ? lo : mid + 1;
+    const int near_hi = diff < 0 ? mid : hi;
+    const int far_lo = diff < 0 ? mid + 1 : lo;
+    const int far_hi = diff < 0 ? hi : mid;
+    SearchKNearest(near_lo, near_hi, qx, qy, k, heap);
+    // Strictly less: with many points at the same distance, such as
+    // duplicates, we'd otherwise visit all of them.
+    if ((int) heap->size() < k || diff * diff < heap->front().dist)
+        SearchKNearest(far_lo, far_hi, qx, qy, k, heap);
+}
+
+void SpatialIndex::FindInBox(const Box &box, std::vector<int> *result) const {
+    result->clear();
+    SearchBox(0, size(), box, result);
+}
+
+void SpatialIndex::SearchBox(int lo, int hi, const Box &box,
+                             std::vector<int> *result) const {
+    if (lo >= hi)
+        return;
+    const int mid = (lo + hi) / 2;
+    if (alive_[mid] == 0)
+        return;
+    const float x = x_[mid], y = y_[mid];
+    if (!removed_[mid] && x >= box.p0.x && x <= box.p1.x
+        && y >= box.p0.y && y <= box.p1.y) {
+        result->push_back(id_[mid]);
+    }
+    const float split = split_y_[mid] ? y : x;
+    const float box_min = split_y_[mid] ? box.p0.y : box.p0.x;
+    const float box_max = split_y_[mid] ? box.p1.y : box.p1.x;
+    if (box_min <= split) SearchBox(lo, mid, box, result);
+    if (box_max >= split) SearchBox(mid + 1, hi, box, result);
+}
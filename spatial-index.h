@@ -0,0 +1,70 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Spatial index over a fixed set of 2D points.
+ */
+#ifndef PNP_SPATIAL_INDEX_H
+#define PNP_SPATIAL_INDEX_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "rpt2pnp.h"
+
+// A k-d tree, built once over "count" points. The ID of a point is its
+// index in the arrays it was built from.
+// Points can be removed, e.g. once visited; queries only return points that
+// are still there. Removal is O(log n) and keeps queries O(log n) on
+// average. The index is a plain value type, so to remove points without
+// affecting the original, work on a copy.
+class SpatialIndex {
+public:
+    SpatialIndex();
+    SpatialIndex(const float *x, const float *y, int count);
+
+    int size() const { return x_.size(); }
+    int remaining() const { return remaining_; }
+
+    // Nearest point; among equally distant points the one with the lowest
+    // ID. Returns -1 if there are no points.
+    int FindNearest(const Position &pos) const;
+
+    // Up to "k" nearest points, closest first. Which of several points at
+    // the same distance make the cut is not specified.
+    void FindKNearest(const Position &pos, int k,
+                      std::vector<int> *result) const;
+
+    // All points within the box, edges included. In no particular order.
+    void FindInBox(const Box &box, std::vector<int> *result) const;
+
+    void Remove(int id);
+    bool IsRemoved(int id) const { return removed_[node_of_[id]]; }
+
+private:
+    struct Candidate;
+    struct Point;
+    void Build(std::vector<Point> *points, int lo, int hi);
+    void SearchNearest(int lo, int hi, float qx, float qy,
+                       int *best_node, float *best_dist) const;
+    void SearchKNearest(int lo, int hi, float qx, float qy, int k,
+                        std::vector<Candidate> *heap) const;
+    void SearchBox(int lo, int hi, const Box &box,
+                   std::vector<int> *result) const;
+
+    // The tree is implicit: the node for the range [lo, hi) is at
+    // (lo + hi) / 2, the left subtree is [lo, mid), the right [mid + 1, hi).
+    // All arrays are indexed by node.
+    std::vector<float> x_, y_;
+    std::vector<int> id_;            // Point ID of each node.
+    std::vector<uint8_t> split_y_;   // Split along y (otherwise x).
+    std::vector<uint8_t> removed_;
+    // Number of points not removed in the subtree at this node. Lets queries
+    // skip subtrees that are used up, so that removing most of the points
+    // doesn't make queries more expensive.
+    std::vector<int> alive_;
+    std::vector<int> node_of_;       // Point ID -> node.
+    int remaining_;
+};
+
+#endif  // PNP_SPATIAL_INDEX_H
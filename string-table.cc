@@ -0,0 +1,62 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ */
+
+#include "string-table.h"
+
+#include <string.h>
+
+StringTable::StringTable() : slots_(64, -1) {
+    Intern("", 0);
+}
+
+uint32_t StringTable::Hash(const char *str, size_t len) {
+    uint32_t hash = 0x811c9dc5;   // FNV-1a
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ (unsigned char) str[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+// Returns slot that either contains the string or is empty.
+int StringTable::FindSlot(const char *str, size_t len, uint32_t hash) const {
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask; /**/; slot = (slot + 1) & mask) {
+        const int id = slots_[slot];
+        if (id < 0
+            || (hash_[id] == hash && length_[id] == len
+                && memcmp(str_[id], str, len) == 0)) {
+            return slot;
+        }
+    }
+}
+
+void StringTable::Rehash(size_t slot_count) {
+    slots_.assign(slot_count, -1);
+    const size_t mask = slot_count - 1;
+    for (int id = 0; id < size(); ++id) {
+        size_t slot = hash_[id] & mask;
+        while (slots_[slot] >= 0) slot = (slot + 1) & mask;
+        slots_[slot] = id;
+    }
+}
+
+int StringTable::Intern(const char *str, size_t len) {
+    const uint32_t hash = Hash(str, len);
+    const int slot = FindSlot(str, len, hash);
+    if (slots_[slot] >= 0)
+        return slots_[slot];
+    const int id = size();
+    str_.push_back(arena_.StoreString(str, len));
+    length_.push_back(len);
+    hash_.push_back(hash);
+    slots_[slot] = id;
+    if (2 * str_.size() > slots_.size())   // Keep load factor below 1/2
+        Rehash(2 * slots_.size());
+    return id;
+}
+
+int StringTable::Find(const char *str, size_t len) const {
+    const int slot = FindSlot(str, len, Hash(str, len));
+    return slots_[slot];
+}
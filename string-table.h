@@ -0,0 +1,53 @@
+/* -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * (c) h.zeller@acm.org. Free Software. GNU Public License v3.0 and above
+ *
+ * Interning of strings: each distinct string is stored once and gets a
+ * small integer ID.
+ */
+#ifndef PNP_STRING_TABLE_H
+#define PNP_STRING_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "arena.h"
+
+class StringTable {
+public:
+    StringTable();
+
+    // Returns ID of the string, adding it if it is not there yet. IDs are
+    // handed out in sequence. ID 0 is always the empty string.
+    int Intern(const char *str, size_t len);
+    int Intern(const std::string &s) { return Intern(s.data(), s.size()); }
+
+    // Returns the ID of the string or -1 if it is not in the table.
+    int Find(const char *str, size_t len) const;
+    int Find(const std::string &s) const { return Find(s.data(), s.size()); }
+
+    // Nul-terminated string for given ID. Stays valid for the lifetime of
+    // the table.
+    const char *str(int id) const { return str_[id]; }
+    size_t length(int id) const { return length_[id]; }
+
+    int size() const { return str_.size(); }
+
+    // The arena holding the characters.
+    const Arena &arena() const { return arena_; }
+
+private:
+    static uint32_t Hash(const char *str, size_t len);
+    int FindSlot(const char *str, size_t len, uint32_t hash) const;
+    void Rehash(size_t slot_count);
+
+    Arena arena_;
+    std::vector<const char*> str_;
+    std::vector<uint32_t> length_;
+    std::vector<uint32_t> hash_;
+    std::vector<int> slots_;   // Open addressing: string ID or -1.
+};
+
+#endif  // PNP_STRING_TABLE_H